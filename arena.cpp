@@ -0,0 +1,109 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t size) {
+    size_t result = 1;
+    while (result < size) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace
+
+// QueryArena
+
+QueryArena::QueryArena()
+    : buffer_(&TakeThreadBuffer())
+{
+}
+
+QueryArena::~QueryArena() {
+    ReturnThreadBuffer(*buffer_);
+}
+
+std::pmr::memory_resource* QueryArena::Resource() {
+    return &*buffer_->resource;
+}
+
+// PRIVATE
+
+void* QueryArena::OverflowResource::do_allocate(size_t bytes,
+                                                size_t alignment) {
+    overflow_size += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void QueryArena::OverflowResource::do_deallocate(void* p, size_t bytes,
+                                                 size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool QueryArena::OverflowResource::do_is_equal(
+     const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+// The buffers of a thread form a stack, arenas of nested queries take
+// them in order. Buffers stay with the thread until it exits.
+struct QueryArena::ThreadBuffers {
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    size_t depth = 0;
+};
+
+QueryArena::ThreadBuffers& QueryArena::GetThreadBuffers() {
+    static thread_local ThreadBuffers thread_buffers;
+    return thread_buffers;
+}
+
+QueryArena::Buffer& QueryArena::TakeThreadBuffer() {
+    auto& [buffers, depth] = GetThreadBuffers();
+    if (depth == buffers.size()) {
+        auto& buffer = *buffers.emplace_back(std::make_unique<Buffer>());
+        buffer.data = std::make_unique<std::byte[]>(MIN_BUFFER_SIZE);
+        buffer.size = MIN_BUFFER_SIZE;
+        buffer.resource.emplace(buffer.data.get(), buffer.size,
+                                &buffer.overflow);
+    }
+    return *buffers[depth++];
+}
+
+// Rewinds the buffer. When the query needed more, the buffer is
+// replaced by one large enough for it; if that allocation fails the old
+// buffer is kept.
+void QueryArena::ReturnThreadBuffer(Buffer& buffer) {
+    buffer.resource.reset();
+    if (buffer.overflow.overflow_size > 0 && buffer.size < MAX_BUFFER_SIZE) {
+        const size_t size = std::min(MAX_BUFFER_SIZE, RoundUpToPowerOfTwo(
+                            buffer.size + buffer.overflow.overflow_size));
+        if (std::byte* data = new (std::nothrow) std::byte[size]) {
+            buffer.data.reset(data);
+            buffer.size = size;
+        }
+    }
+    buffer.overflow.overflow_size = 0;
+    buffer.resource.emplace(buffer.data.get(), buffer.size,
+                            &buffer.overflow);
+    --GetThreadBuffers().depth;
+}
+
+// IndexArena
+
+IndexArena::IndexArena(std::pmr::memory_resource* upstream)
+    : pool_(std::make_shared<std::pmr::synchronized_pool_resource>(
+            upstream))
+{
+}
+
+IndexArena& IndexArena::operator=(const IndexArena&) {
+    return *this;
+}
+
+std::pmr::memory_resource* IndexArena::Resource() const {
+    return pool_.get();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Scratch memory of one query. The parsed query, the postings it
+// resolves to and the documents it ranks are allocated from the arena
+// and dropped all at once when the arena goes away. Every thread keeps
+// its buffers and its queries reuse them, so a query that fits its
+// buffer touches no allocator. Arenas nest: a query started on a thread
+// whose buffer is taken, e.g. a task a parallel algorithm runs while the
+// outer query waits, gets the next buffer of the thread. A query that
+// outgrows its buffer takes the rest from the heap and the buffer grows
+// for the next one, up to MAX_BUFFER_SIZE.
+class QueryArena {
+public:
+    QueryArena();
+
+    QueryArena(const QueryArena&) = delete;
+
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    ~QueryArena();
+
+    std::pmr::memory_resource* Resource();
+
+private:
+    static constexpr size_t MIN_BUFFER_SIZE = 16 * 1024;
+    static constexpr size_t MAX_BUFFER_SIZE = 16 * 1024 * 1024;
+
+    // Upstream of a buffer, counts the bytes its queries needed beyond
+    // the buffer.
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t overflow_size = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+
+        void do_deallocate(void* p, size_t bytes,
+                           size_t alignment) override;
+
+        bool do_is_equal(const std::pmr::memory_resource& other)
+             const noexcept override;
+    };
+
+    struct Buffer {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+        OverflowResource overflow;
+        std::optional<std::pmr::monotonic_buffer_resource> resource;
+    };
+
+    struct ThreadBuffers;
+
+    Buffer* buffer_;
+
+    static ThreadBuffers& GetThreadBuffers();
+
+    static Buffer& TakeThreadBuffer();
+
+    static void ReturnThreadBuffer(Buffer& buffer);
+};
+
+// Pool the per-document containers of a SearchServer allocate from, over
+// an upstream resource its owner picks. Documents are added and removed
+// one container at a time, so freed blocks are kept for the next ones
+// instead of going back to upstream. The pool is synchronized: parallel
+// batches and lazily loaded snapshot documents allocate from it
+// concurrently. Copies share the pool. Assignment keeps it, the
+// containers of the assigned object still hold memory from it.
+class IndexArena {
+public:
+    explicit IndexArena(std::pmr::memory_resource* upstream
+                            = std::pmr::get_default_resource());
+
+    IndexArena(const IndexArena&) = default;
+
+    IndexArena& operator=(const IndexArena&);
+
+    std::pmr::memory_resource* Resource() const;
+
+private:
+    std::shared_ptr<std::pmr::synchronized_pool_resource> pool_;
+};
@@ -1,58 +1,194 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
 #include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 
 using namespace std::string_literals;
 
+// Hash map striped over independently locked shards. Every shard is an
+// open addressing table with linear probing; a shard sits on its own
+// cache lines so neighbouring locks do not false-share.
 template <typename Key, typename Value>
 class ConcurrentMap {
 public:
     static_assert(std::is_integral_v<Key>,
                   "ConcurrentMap supports only integer keys"s);
 
-    struct Bucket {
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool is_used = false;
+    };
+
+    struct alignas(64) Shard {
         std::mutex mutex_value;
-        std::map<Key, Value> container;
+        std::vector<Slot> slots;
+        size_t size = 0;
     };
 
     struct Access {
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex_value)
-            , ref_to_value(bucket.container[key])
+        Access(const Key& key, Shard& shard)
+            : guard(shard.mutex_value)
+            , ref_to_value(FindOrInsert(shard, key))
         {}
 
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count)
-    {}
+    explicit ConcurrentMap(size_t expected_key_count)
+        : shards_(ShardCount())
+    {
+        const size_t per_shard = expected_key_count / shards_.size() + 1;
+        size_t capacity = MIN_SHARD_CAPACITY;
+        while (capacity * MAX_LOAD_NUMERATOR
+               < per_shard * MAX_LOAD_DENOMINATOR) {
+            capacity *= 2;
+        }
+        for (Shard& shard : shards_) {
+            shard.slots.resize(capacity);
+        }
+    }
 
     Access operator[](const Key& key) {
-        uint64_t id = key;
-        Bucket& bucket = buckets_[id % buckets_.size()];
-        return {key, bucket};
+        return {key, shards_[ShardIndex(key)]};
     };
 
     void Erase(const Key& key) {
-        uint64_t id = key;
-        Bucket& bucket = buckets_[id % buckets_.size()];
-        std::lock_guard guard(bucket.mutex_value);
-        bucket.container.erase(key);
+        Shard& shard = shards_[ShardIndex(key)];
+        std::lock_guard guard(shard.mutex_value);
+        const size_t mask = shard.slots.size() - 1;
+        size_t pos = FindSlot(shard, key);
+        if (!shard.slots[pos].is_used) {
+            return;
+        }
+
+        // Backward shift deletion: later entries of the probe chain
+        // move into the hole, so no tombstones are needed.
+        for (size_t next = (pos + 1) & mask;
+             shard.slots[next].is_used;
+             next = (next + 1) & mask) {
+            const size_t home = SlotIndex(shard.slots[next].key) & mask;
+            if (((next - home) & mask) >= ((next - pos) & mask)) {
+                shard.slots[pos] = std::move(shard.slots[next]);
+                pos = next;
+            }
+        }
+        shard.slots[pos] = Slot{};
+        --shard.size;
+    }
+
+    // Moves every entry out in no particular order and leaves the map
+    // empty.
+    std::vector<std::pair<Key, Value>> Drain() {
+        std::vector<std::pair<Key, Value>> result;
+        for (Shard& shard : shards_) {
+            std::lock_guard guard(shard.mutex_value);
+            result.reserve(result.size() + shard.size);
+            for (Slot& slot : shard.slots) {
+                if (slot.is_used) {
+                    result.emplace_back(slot.key, std::move(slot.value));
+                    slot = Slot{};
+                }
+            }
+            shard.size = 0;
+        }
+        return result;
     }
 
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> result;
-        for (auto& [mutex, container] : buckets_) {
-            std::lock_guard guard(mutex);
-            result.insert(container.begin(), container.end());
+        for (Shard& shard : shards_) {
+            std::lock_guard guard(shard.mutex_value);
+            for (const Slot& slot : shard.slots) {
+                if (slot.is_used) {
+                    result.emplace(slot.key, slot.value);
+                }
+            }
         }
         return result;
     };
 
 private:
-    std::vector<Bucket> buckets_;
+    static const size_t MIN_SHARD_CAPACITY = 16;
+    static const size_t MAX_LOAD_NUMERATOR = 7;
+    static const size_t MAX_LOAD_DENOMINATOR = 10;
+
+    std::vector<Shard> shards_;
+
+    static size_t ShardCount() {
+        const size_t threads = std::max(1u,
+                                        std::thread::hardware_concurrency());
+        size_t count = 1;
+        while (count < 4 * threads) {
+            count *= 2;
+        }
+        return count;
+    }
+
+    static uint64_t Hash(const Key& key) {
+        uint64_t hash = static_cast<uint64_t>(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // Shards take the high bits of the hash and slots the low ones.
+    size_t ShardIndex(const Key& key) const {
+        return (Hash(key) >> 40) & (shards_.size() - 1);
+    }
+
+    static size_t SlotIndex(const Key& key) {
+        return Hash(key);
+    }
+
+    // The slot holding the key, or the empty slot its probe stops at.
+    static size_t FindSlot(const Shard& shard, const Key& key) {
+        const size_t mask = shard.slots.size() - 1;
+        size_t pos = SlotIndex(key) & mask;
+        while (shard.slots[pos].is_used && shard.slots[pos].key != key) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    // Grows only when the key is new, an existing key keeps its slot.
+    static Value& FindOrInsert(Shard& shard, const Key& key) {
+        size_t pos = FindSlot(shard, key);
+        if (shard.slots[pos].is_used) {
+            return shard.slots[pos].value;
+        }
+        if ((shard.size + 1) * MAX_LOAD_DENOMINATOR
+            > shard.slots.size() * MAX_LOAD_NUMERATOR) {
+            Grow(shard);
+            pos = FindSlot(shard, key);
+        }
+        Slot& slot = shard.slots[pos];
+        slot.key = key;
+        slot.is_used = true;
+        ++shard.size;
+        return slot.value;
+    }
+
+    static void Grow(Shard& shard) {
+        std::vector<Slot> slots(shard.slots.size() * 2);
+        const size_t mask = slots.size() - 1;
+        for (Slot& slot : shard.slots) {
+            if (!slot.is_used) {
+                continue;
+            }
+            size_t pos = SlotIndex(slot.key) & mask;
+            while (slots[pos].is_used) {
+                pos = (pos + 1) & mask;
+            }
+            slots[pos] = std::move(slot);
+        }
+        shard.slots = std::move(slots);
+    }
 };
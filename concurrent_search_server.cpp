@@ -0,0 +1,62 @@
+#include "concurrent_search_server.h"
+
+// PUBLIC
+
+void ConcurrentSearchServer::AddDocument(int document_id,
+                             const std::string_view document,
+                             DocumentStatus status,
+                             const std::vector<int>& ratings) {
+    Write([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(
+                             const std::vector<DocumentInput>& documents) {
+    Write([&documents](SearchServer& search_server) {
+        search_server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::Compact() {
+    Write([](SearchServer& search_server) {
+        search_server.Compact();
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& search_server) {
+        return search_server.GetDocumentCount();
+    });
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+ConcurrentSearchServer::MatchDocument(const std::string_view raw_query,
+                                      int document_id) const {
+    return Read([raw_query, document_id](const SearchServer& search_server) {
+        return search_server.MatchDocument(raw_query, document_id);
+    });
+}
+
+// PRIVATE
+
+size_t ConcurrentSearchServer::GetReaderSlot() {
+    static std::atomic<size_t> next_slot{0};
+    thread_local const size_t slot = next_slot.fetch_add(1)
+                                     % READER_SLOT_COUNT;
+    return slot;
+}
+
+void ConcurrentSearchServer::WaitForReaders(int replica) const {
+    for (const ReaderSlot& slot : readers_[replica]) {
+        while (slot.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// SearchServer that answers queries while documents are added and
+// removed. Two replicas of the index are kept (the left-right scheme):
+// queries run on the published replica without taking any lock, a
+// change is made on the other replica, which is then published. Once
+// the queries that pinned the old replica have finished, the same
+// change is repeated there, so both end up equal. Changes are
+// serialized and cost about twice what they cost on a SearchServer;
+// queries never wait for them.
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words);
+
+    void AddDocument(int document_id,
+                     const std::string_view document,
+                     DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void Compact();
+
+// Calls function(const SearchServer&) on the published replica, which
+// does not change until function returns. Views into the replica, like
+// the words MatchDocument returns, stay valid as long as the server:
+// words are never dropped from a vocabulary.
+    template <typename Function>
+    auto Read(Function function) const;
+
+    int GetDocumentCount() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(const Args&... args) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(const std::string_view raw_query, int document_id) const;
+
+private:
+    static const size_t READER_SLOT_COUNT = 64;
+
+    // Readers in progress on a replica, counted over slots on their own
+    // cache lines; a thread always takes the same slot.
+    struct alignas(64) ReaderSlot {
+        std::atomic<int> count{0};
+    };
+
+    SearchServer replicas_[2];
+    std::atomic<int> published_{0};
+    mutable ReaderSlot readers_[2][READER_SLOT_COUNT];
+    std::mutex write_mutex_;
+
+    static size_t GetReaderSlot();
+
+    // Applies change(SearchServer&) to both replicas. A change that
+    // throws on the first one leaves the server as it was.
+    template <typename Change>
+    void Write(Change change);
+
+    void WaitForReaders(int replica) const;
+};
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(
+                        const StringContainer& stop_words)
+    : replicas_{ SearchServer(stop_words), SearchServer(stop_words) }
+{
+}
+
+// A reader announces itself on the replica it found published and then
+// checks that it still is; if not, a writer may already be waiting for
+// that replica and the reader moves on to the new one.
+template <typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    const size_t slot = GetReaderSlot();
+    int replica = published_.load();
+    while (true) {
+        readers_[replica][slot].count.fetch_add(1);
+        const int published = published_.load();
+        if (published == replica) {
+            break;
+        }
+        readers_[replica][slot].count.fetch_sub(1);
+        replica = published;
+    }
+
+    struct Unpin {
+        std::atomic<int>& count;
+
+        ~Unpin() {
+            count.fetch_sub(1);
+        }
+    } unpin{ readers_[replica][slot].count };
+    return function(replicas_[replica]);
+}
+
+template <typename... Args>
+std::vector<Document>
+ConcurrentSearchServer::FindTopDocuments(const Args&... args) const {
+    return Read([&args...](const SearchServer& search_server) {
+        return search_server.FindTopDocuments(args...);
+    });
+}
+
+template <typename Change>
+void ConcurrentSearchServer::Write(Change change) {
+    std::lock_guard guard(write_mutex_);
+    const int published = published_.load();
+    change(replicas_[1 - published]);
+    published_.store(1 - published);
+    WaitForReaders(published);
+    change(replicas_[published]);
+}
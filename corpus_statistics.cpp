@@ -0,0 +1,10 @@
+#include "corpus_statistics.h"
+
+CorpusStatistics&
+CorpusStatistics::operator+=(const CorpusStatistics& other) {
+    document_count += other.document_count;
+    for (const auto [word, document_freq] : other.document_freqs) {
+        document_freqs[word] += document_freq;
+    }
+    return *this;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <map>
+#include <string_view>
+
+// Collection-wide counts the inverse document frequencies are computed
+// from. Statistics of several partitions of one collection add up to
+// the statistics of the whole collection.
+struct CorpusStatistics {
+    int document_count = 0;
+    std::map<std::string_view, int> document_freqs;
+
+    CorpusStatistics& operator+=(const CorpusStatistics& other);
+};
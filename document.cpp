@@ -1,5 +1,7 @@
 #include "document.h"
 
+#include <cmath>
+
 using namespace std::string_literals;
 
 Document::Document(int id, double relevance, int rating)
@@ -16,6 +18,16 @@ std::ostream& operator<<(std::ostream& out,
     return out;
 }
 
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < MIN_REAL_VALUE) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 void PrintDocument(const Document& document) {
     std::cout << "{ "
         << "document_id = " << document.id << ", "
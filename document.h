@@ -1,8 +1,11 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 #include <vector>
 
+const double MIN_REAL_VALUE = 1e-6;
+
 struct Document {
     Document() = default;
 
@@ -20,9 +23,25 @@ enum class DocumentStatus {
     REMOVED
 };
 
+// One document of a SearchServer::AddDocuments batch, text only has to
+// live until the call returns.
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream& operator<<(std::ostream& out,
                          const Document& document);
 
+// Result ranking order: higher relevance first, relevances closer
+// than MIN_REAL_VALUE are ordered by rating, then by smaller id. The id
+// makes the order total, so every search path, the pruned top-k heap
+// included, picks the same documents among ties. SearchServer ranks
+// with internal indexes as ids, i.e. in the order documents were added.
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
 void PrintDocument(const Document& document);
 
 void PrintMatchDocumentResult(int document_id,
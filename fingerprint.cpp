@@ -0,0 +1,55 @@
+#include "fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// MurmurHash3 finalizer.
+uint64_t Finalize(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccd;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53;
+    value ^= value >> 33;
+    return value;
+}
+
+const uint64_t LOW_SEED = 0x243f6a8885a308d3;
+const uint64_t HIGH_SEED = 0x13198a2e03707344;
+const uint64_t HIGH_STEP = 0x9e3779b97f4a7c15;
+
+} // namespace
+
+Fingerprint& Fingerprint::operator+=(const Fingerprint& other) {
+    low += other.low;
+    high += other.high;
+    return *this;
+}
+
+bool operator==(const Fingerprint& lhs, const Fingerprint& rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+bool operator!=(const Fingerprint& lhs, const Fingerprint& rhs) {
+    return !(lhs == rhs);
+}
+
+// The lanes hash the word 8 bytes at a time from different seeds and
+// with different steps, the length goes into both.
+Fingerprint HashWord(std::string_view word) {
+    uint64_t low = LOW_SEED ^ word.size();
+    uint64_t high = HIGH_SEED + word.size() * HIGH_STEP;
+    for (size_t i = 0; i < word.size(); i += sizeof(uint64_t)) {
+        uint64_t chunk = 0;
+        std::memcpy(&chunk, word.data() + i,
+                    std::min(sizeof(uint64_t), word.size() - i));
+        low = Finalize(low ^ chunk);
+        high = Finalize(high + chunk) + HIGH_STEP;
+    }
+    return { Finalize(low), Finalize(high ^ low) };
+}
+
+size_t FingerprintHash::operator()(const Fingerprint& fingerprint) const {
+    return fingerprint.low;
+}
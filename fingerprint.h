@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Fingerprint of a set of words: the sum, lane by lane, of 128-bit
+// hashes of its words. A sum does not depend on the order of its terms,
+// so the fingerprint of a document is added up from the hashes of its
+// distinct words as they come. Two different sets get the same
+// fingerprint with a chance of about 2^-128.
+struct Fingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    Fingerprint& operator+=(const Fingerprint& other);
+};
+
+bool operator==(const Fingerprint& lhs, const Fingerprint& rhs);
+
+bool operator!=(const Fingerprint& lhs, const Fingerprint& rhs);
+
+Fingerprint HashWord(std::string_view word);
+
+struct FingerprintHash {
+    size_t operator()(const Fingerprint& fingerprint) const;
+};
@@ -0,0 +1,69 @@
+#include "index_bitmap.h"
+
+IndexBitmap::IndexBitmap(std::pmr::memory_resource* resource)
+    : chunks_(resource)
+{
+}
+
+void IndexBitmap::Add(int index) {
+    const size_t chunk_index = index >> CHUNK_BITS;
+    const uint16_t low = index & ((1 << CHUNK_BITS) - 1);
+    if (chunks_.size() <= chunk_index) {
+        chunks_.resize(chunk_index + 1);
+    }
+    Chunk& chunk = chunks_[chunk_index];
+
+    auto& values = chunk.values;
+    if (chunk.bits.empty()) {
+        if (values.empty() || values.back() < low) {
+            values.push_back(low);
+            ++size_;
+            if (values.size() > ARRAY_LIMIT) {
+                MakeBitmap(chunk);
+            }
+            return;
+        }
+        const auto it = std::lower_bound(values.begin(), values.end(), low);
+        if (*it == low) {
+            return;
+        }
+        if (values.size() < SHIFT_LIMIT) {
+            values.insert(it, low);
+            ++size_;
+            return;
+        }
+        MakeBitmap(chunk);
+    }
+
+    uint64_t& word = chunk.bits[low >> 6];
+    const uint64_t bit = uint64_t{1} << (low & 63);
+    size_ += (word & bit) == 0;
+    word |= bit;
+}
+
+bool IndexBitmap::Empty() const {
+    return size_ == 0;
+}
+
+// PRIVATE
+
+IndexBitmap::Chunk::Chunk(const allocator_type& allocator)
+    : values(allocator)
+    , bits(allocator)
+{
+}
+
+IndexBitmap::Chunk::Chunk(Chunk&& other, const allocator_type& allocator)
+    : values(std::move(other.values), allocator)
+    , bits(std::move(other.bits), allocator)
+{
+}
+
+void IndexBitmap::MakeBitmap(Chunk& chunk) {
+    chunk.bits.assign((1 << CHUNK_BITS) / 64, 0);
+    for (const uint16_t value : chunk.values) {
+        chunk.bits[value >> 6] |= uint64_t{1} << (value & 63);
+    }
+    chunk.values.clear();
+    chunk.values.shrink_to_fit();
+}
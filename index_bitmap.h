@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Set of internal document indexes, roaring-style: the index space is
+// cut into chunks of 2^16 and every chunk keeps its indexes as a sorted
+// array until it holds more than ARRAY_LIMIT of them, then as a plain
+// bitmap. A sparse set stays small, a dense one costs a bit test.
+// Indexes added out of order to an array longer than SHIFT_LIMIT also
+// turn it into a bitmap, so merging several posting lists never shifts
+// long arrays.
+class IndexBitmap {
+public:
+    explicit IndexBitmap(std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource());
+
+    void Add(int index);
+
+    // Called for every scored posting, so it is defined inline.
+    bool Contains(int index) const {
+        const size_t chunk_index = index >> CHUNK_BITS;
+        if (chunk_index >= chunks_.size()) {
+            return false;
+        }
+        const Chunk& chunk = chunks_[chunk_index];
+        const uint16_t low = index & ((1 << CHUNK_BITS) - 1);
+        if (!chunk.bits.empty()) {
+            return (chunk.bits[low >> 6] >> (low & 63)) & 1;
+        }
+        return std::binary_search(chunk.values.begin(),
+                                  chunk.values.end(), low);
+    }
+
+    bool Empty() const;
+
+private:
+    static const int CHUNK_BITS = 16;
+    static const size_t ARRAY_LIMIT = 4096;
+    static const size_t SHIFT_LIMIT = 64;
+
+    // Allocator-aware, chunks take the resource of the bitmap.
+    struct Chunk {
+        using allocator_type = std::pmr::polymorphic_allocator<Chunk>;
+
+        explicit Chunk(const allocator_type& allocator);
+
+        Chunk(Chunk&& other, const allocator_type& allocator);
+
+        std::pmr::vector<uint16_t> values;
+        std::pmr::vector<uint64_t> bits;
+    };
+
+    std::pmr::vector<Chunk> chunks_;
+    size_t size_ = 0;
+
+    static void MakeBitmap(Chunk& chunk);
+};
@@ -28,7 +28,34 @@ void RemoveDuplicates(SearchServer& search_server) {
     }
 }
 
+// Keeps the first document of every group of near-duplicates.
+void RemoveDuplicates(SearchServer& search_server, double threshold) {
+    std::vector<int> duplicates;
+    for (const auto& group : search_server.GetNearDuplicates(threshold)) {
+        duplicates.insert(duplicates.end(), group.begin() + 1, group.end());
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    for (const auto id : duplicates) {
+        std::cout << "Found duplicate document id "s
+                  << id << std::endl;
+        search_server.RemoveDocument(id);
+    }
+}
+
 int main() {
+/// ConcurrentMap test
+    {
+        std::mt19937 generator;
+        const auto dense_keys = GenerateKeys(generator, 1'000'000,
+                                             100'000);
+        const auto sparse_keys = GenerateKeys(generator, 1'000'000,
+                                              1'000'000'000);
+        TEST_CONCURRENT_MAP_INSERT(dense_keys);
+        TEST_CONCURRENT_MAP_INSERT(sparse_keys);
+        TEST_CONCURRENT_MAP_ERASE(dense_keys);
+        TEST_CONCURRENT_MAP_ERASE(sparse_keys);
+    }
+
 /// ProcessQueries test
     {
         std::mt19937 generator;
@@ -49,6 +76,34 @@ int main() {
         TEST_PROCESS_QUERIES(ProcessQueries);
     }
 
+/// Query cache test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   2'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               20'000, 10);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
+                            {1, 2, 3});
+        }
+
+        const auto queries = GenerateSkewedQueries(generator,
+            GenerateQueries(generator, dictionary, 20'000, 7), 20'000);
+        Test_Process_Queries("ProcessQueries without cache"sv,
+                             ProcessQueries, ss, queries);
+        ss.SetQueryCache(2'000);
+        Test_Process_Queries("ProcessQueries with cache"sv,
+                             ProcessQueries, ss, queries);
+        const QueryCacheStatistics statistics
+            = ss.GetQueryCacheStatistics();
+        std::cout << "Query cache hits "s << statistics.hits
+                  << ", misses "s << statistics.misses << std::endl;
+    }
+
 /// ProcessQueriesJoined test
     {
         SearchServer ss("and with"s);
@@ -79,6 +134,146 @@ int main() {
         }
     }
 
+/// AddDocument test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               50'000, 100);
+        Test_Split_Into_Words("ForEachWord "s + TextKernelName(),
+                              documents);
+        Test_Add_Document("AddDocument"sv, dictionary[0], documents);
+        Test_Add_Documents("AddDocuments"sv, dictionary[0], documents);
+    }
+
+/// Snapshot test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               50'000, 100);
+        const auto queries = GenerateQueries(generator, dictionary,
+                                             100, 10);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        const std::string path = "search_server.snapshot"s;
+        ss.SaveSnapshot(path);
+        Test_Load_Snapshot("LoadSnapshot and 100 queries"sv, path,
+                           queries);
+        std::remove(path.c_str());
+    }
+
+/// Write-ahead log test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               5'000, 100);
+        const std::string log_path = "search_server.log"s;
+        const std::string snapshot_path = "search_server.snapshot"s;
+
+        Test_Add_Document("AddDocument without log"sv, dictionary[0],
+                          documents);
+        Test_Add_Document_Logged("AddDocument with sync log"sv,
+                                 dictionary[0], documents, log_path,
+                                 LogDurability::SYNC);
+        Test_Add_Document_Logged("AddDocument with deferred log"sv,
+                                 dictionary[0], documents, log_path,
+                                 LogDurability::DEFERRED);
+
+        // Snapshot of the first half, the second half is only logged.
+        std::remove(log_path.c_str());
+        {
+            SearchServer ss(dictionary[0]);
+            auto log = std::make_shared<WriteAheadLog>(log_path);
+            ss.AttachLog(log, LogDurability::DEFERRED);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                if (i == documents.size() / 2) {
+                    ss.SaveSnapshot(snapshot_path);
+                }
+                ss.AddDocument(i, documents[i],
+                               DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+        Test_Recover("LoadSnapshot and ReplayLog"sv, snapshot_path,
+                     log_path);
+        std::remove(log_path.c_str());
+        std::remove(snapshot_path.c_str());
+    }
+
+/// Concurrent updates test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               20'000, 100);
+        const auto queries = GenerateQueries(generator, dictionary,
+                                             20'000, 7);
+
+        // Every step adds a document and removes the one added 1000
+        // steps earlier, the index size stays about the same.
+        std::vector<DocumentInput> batch;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({ static_cast<int>(i), documents[i],
+                              DocumentStatus::ACTUAL, {1, 2, 3} });
+        }
+        const int first_id = documents.size();
+        const auto step_document = [&documents](int step) {
+            return std::string_view(documents[step % documents.size()]);
+        };
+
+        {
+            ConcurrentSearchServer ss(dictionary[0]);
+            ss.AddDocuments(batch);
+            const auto query = [&ss](const std::string& raw_query) {
+                return ss.FindTopDocuments(raw_query);
+            };
+            Test_Queries_With_Updates("left-right, no updates"sv, queries,
+                query, [](int) {
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(1));
+                    return false;
+                });
+            Test_Queries_With_Updates("left-right, updates"sv, queries,
+                query, [&](int step) {
+                    ss.AddDocument(first_id + step, step_document(step),
+                                   DocumentStatus::ACTUAL, {1});
+                    ss.RemoveDocument(first_id + step - 1000);
+                    return true;
+                });
+        }
+
+        {
+            SearchServer ss(dictionary[0]);
+            ss.AddDocuments(batch);
+            std::shared_mutex mutex;
+            Test_Queries_With_Updates("shared_mutex, updates"sv, queries,
+                [&ss, &mutex](const std::string& raw_query) {
+                    std::shared_lock lock(mutex);
+                    return ss.FindTopDocuments(raw_query);
+                },
+                [&](int step) {
+                    std::unique_lock lock(mutex);
+                    ss.AddDocument(first_id + step, step_document(step),
+                                   DocumentStatus::ACTUAL, {1});
+                    ss.RemoveDocument(first_id + step - 1000);
+                    return true;
+                });
+        }
+    }
+
 /// RemoveDocument test
     {
         std::mt19937 generator;
@@ -107,6 +302,50 @@ int main() {
         }
     }
 
+/// Compact test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               50'000, 100);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        Test_Remove_And_Compact("RemoveDocument 10% and Compact"sv, ss,
+                                5'000);
+    }
+
+/// Near-duplicates test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        auto documents = GenerateQueries(generator,
+                                         dictionary,
+                                         50'000, 100);
+        for (auto& copy : GenerateNearCopies(generator, documents,
+                                             dictionary, 5'000, 3)) {
+            documents.push_back(std::move(copy));
+        }
+        for (auto& copy : GenerateNearCopies(generator, documents,
+                                             dictionary, 5'000, 0)) {
+            documents.push_back(std::move(copy));
+        }
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        Test_Near_Duplicates("GetNearDuplicates 0.8"sv, ss, 0.8);
+        Test_Duplicates("GetDuplicates"sv, ss);
+    }
+
 /// MatchDocument test
     {
         std::mt19937 generator;
@@ -127,6 +366,27 @@ int main() {
 
         TEST_MATCH_DOCUMENT(seq);
         TEST_MATCH_DOCUMENT(par);
+        Test_Match_Document_Prepared("prepared"sv, ss, queries);
+        Test_Match_Documents("MatchDocuments"sv, ss, queries);
+    }
+
+/// GetWordFrequencies test
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   10'000, 25);
+        const auto documents = GenerateQueries(generator,
+                                               dictionary,
+                                               50'000, 100);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+
+        TEST_WORD_FREQUENCIES(seq);
+        TEST_WORD_FREQUENCIES(par);
     }
 
 /// FindDocument test
@@ -149,6 +409,64 @@ int main() {
                                               100, 70);
         TEST_FIND_DOCUMENT(seq);
         TEST_FIND_DOCUMENT(par);
+
+        ShardedSearchServer sharded_ss_4(dictionary[0], 4);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            sharded_ss_4.AddDocument(i, documents[i],
+                                     DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        TEST_FIND_DOCUMENT_SHARDED(4);
+    }
+
+/// FindDocument test on queries with many minus-words
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   1000, 10);
+        const auto documents = GenerateQueries2(generator,
+                                                dictionary,
+                                                20'000, 70);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+
+        std::vector<std::string> queries;
+        for (int i = 0; i < 100; ++i) {
+            queries.push_back(GenerateQuery2(generator, dictionary,
+                                             50, 0.8));
+        }
+        TEST_FIND_DOCUMENT(seq);
+        TEST_FIND_DOCUMENT(par);
+    }
+
+/// Parallel FindDocument test on broad queries
+    {
+        std::mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator,
+                                                   200, 10);
+        const auto documents = GenerateQueries2(generator,
+                                                dictionary,
+                                                50'000, 70);
+
+        SearchServer ss(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ss.AddDocument(i, documents[i],
+                           DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+
+        const auto queries = GenerateQueries2(generator,
+                                              dictionary,
+                                              100, 20);
+        TEST_FIND_DOCUMENT(seq);
+        TEST_FIND_DOCUMENT(par);
+
+        const auto short_queries = GenerateQueries2(generator,
+                                                    dictionary,
+                                                    1'000, 3);
+        TEST_FIND_DOCUMENT_WITH_ALL_WORDS(short_queries);
     }
 
     return 0;
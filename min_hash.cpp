@@ -0,0 +1,82 @@
+#include "min_hash.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// SplitMix64 finalizer.
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111eb;
+    value ^= value >> 31;
+    return value;
+}
+
+const uint64_t TERM_SEED = 0x9e3779b97f4a7c15;
+const uint32_t BORROW_STEP = 0x9e3779b9;
+
+} // namespace
+
+// MinHasher
+
+MinHasher::MinHasher() {
+    bins_.fill(std::numeric_limits<uint32_t>::max());
+}
+
+void MinHasher::Add(uint32_t term) {
+    const uint64_t hash = Mix(term + TERM_SEED);
+    const size_t bin = hash >> 58;
+    const auto value = static_cast<uint32_t>(hash);
+    if (value < bins_[bin]) {
+        bins_[bin] = value;
+    }
+    filled_ |= uint64_t{1} << bin;
+}
+
+// A set without terms keeps all bins at the maximum.
+void MinHasher::Finish(uint32_t* signature) const {
+    for (size_t bin = 0; bin < MIN_HASH_SIZE; ++bin) {
+        if (filled_ == 0 || (filled_ >> bin) & 1) {
+            signature[bin] = bins_[bin];
+            continue;
+        }
+        size_t source = bin;
+        uint32_t distance = 0;
+        do {
+            source = (source + 1) % MIN_HASH_SIZE;
+            ++distance;
+        } while (((filled_ >> source) & 1) == 0);
+        signature[bin] = bins_[source] + distance * BORROW_STEP;
+    }
+}
+
+// LSH
+
+// Very low thresholds miss MIN_LSH_RECALL with every split and take
+// single value bands, the most sensitive ones.
+LshBands ChooseLshBands(double threshold) {
+    LshBands result{ MIN_HASH_SIZE, 1 };
+    double best_rise = 0.0;
+    for (size_t band_size = 1; band_size <= MIN_HASH_SIZE; ++band_size) {
+        const size_t band_count = MIN_HASH_SIZE / band_size;
+        const double recall = 1.0 - std::pow(
+            1.0 - std::pow(threshold, band_size), band_count);
+        const double rise = std::pow(1.0 / band_count, 1.0 / band_size);
+        if (recall >= MIN_LSH_RECALL && rise >= best_rise) {
+            best_rise = rise;
+            result = { band_count, band_size };
+        }
+    }
+    return result;
+}
+
+uint64_t HashLshBand(const uint32_t* values, size_t band_size) {
+    uint64_t hash = band_size;
+    for (size_t i = 0; i < band_size; ++i) {
+        hash = Mix(hash ^ values[i]) + i;
+    }
+    return hash;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// MinHash signatures of term id sets for near-duplicate search. The
+// probability that two signatures agree in a position is the Jaccard
+// similarity of the two sets.
+//
+// Signatures use one permutation hashing: every term is hashed once,
+// the hash picks one of MIN_HASH_SIZE bins and the bin keeps the
+// smallest value that falls into it. Empty bins borrow the value of
+// the next filled bin to the right, shifted by the distance, so small
+// sets still get full signatures. Equal sets always get equal
+// signatures.
+const size_t MIN_HASH_SIZE = 64;
+
+class MinHasher {
+public:
+    MinHasher();
+
+    // Terms have to be distinct.
+    void Add(uint32_t term);
+
+    // Writes MIN_HASH_SIZE values.
+    void Finish(uint32_t* signature) const;
+
+private:
+    std::array<uint32_t, MIN_HASH_SIZE> bins_;
+    uint64_t filled_ = 0;
+};
+
+// Locality-sensitive hashing over signatures: they are cut into
+// band_count bands of band_size values, and two sets are candidates
+// when they agree in all values of some band. The chance of that is
+// 1 - (1 - s^band_size)^band_count for similarity s, an S-curve that
+// rises around (1 / band_count)^(1 / band_size).
+struct LshBands {
+    size_t band_count = 1;
+    size_t band_size = MIN_HASH_SIZE;
+};
+
+// The bands that find a pair of similarity threshold with probability
+// MIN_LSH_RECALL or more and let the fewest dissimilar pairs through,
+// i.e. whose S-curve rises latest. Threshold 1 gives one band of the
+// whole signature.
+const double MIN_LSH_RECALL = 0.95;
+
+LshBands ChooseLshBands(double threshold);
+
+uint64_t HashLshBand(const uint32_t* values, size_t band_size);
@@ -0,0 +1,199 @@
+#include "posting_codec.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define POSTING_CODEC_X86
+#define POSTING_CODEC_TARGET_SSSE3
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define POSTING_CODEC_X86
+#define POSTING_CODEC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+namespace {
+
+using DecodeFunction = const uint8_t* (*)(const uint8_t*, size_t,
+                                          uint32_t*);
+
+size_t ByteLength(uint32_t value) {
+    return value < (1u << 8) ? 1
+         : value < (1u << 16) ? 2
+         : value < (1u << 24) ? 3
+         : 4;
+}
+
+uint32_t LoadValue(const uint8_t* in, size_t length) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+const uint8_t* DecodeScalar(const uint8_t* in, size_t count,
+                            uint32_t* values) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        values[i] = LoadValue(data, length);
+        data += length;
+    }
+    return data;
+}
+
+#ifdef POSTING_CODEC_X86
+
+struct ShuffleTables {
+    std::array<std::array<uint8_t, 16>, 256> masks;
+    std::array<uint8_t, 256> lengths;
+
+    ShuffleTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t source = 0;
+            for (int value = 0; value < 4; ++value) {
+                const int length = ((control >> (2 * value)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    masks[control][4 * value + byte] =
+                        byte < length ? source++ : 0x80;
+                }
+            }
+            lengths[control] = source;
+        }
+    }
+};
+
+const ShuffleTables& GetShuffleTables() {
+    static const ShuffleTables tables;
+    return tables;
+}
+
+bool HasSsse3() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// Four values per control byte with one shuffle; groups whose 16 byte
+// load would run past the block end are left to the scalar loop.
+POSTING_CODEC_TARGET_SSSE3
+const uint8_t* DecodeSsse3(const uint8_t* in, size_t count,
+                           uint32_t* values) {
+    const ShuffleTables& tables = GetShuffleTables();
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+
+    // The unused lanes of a last partial control byte are not counted,
+    // their zero bits would read as one byte values.
+    size_t data_size = 0;
+    for (size_t i = 0; i < count / 4; ++i) {
+        data_size += tables.lengths[control[i]];
+    }
+    for (size_t i = count / 4 * 4; i < count; ++i) {
+        data_size += ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    }
+    const uint8_t* data_end = data + data_size;
+
+    size_t i = 0;
+    for (; i + 4 <= count && data + 16 <= data_end; i += 4) {
+        const uint8_t key = control[i / 4];
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i mask = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(tables.masks[key].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i),
+                         _mm_shuffle_epi8(bytes, mask));
+        data += tables.lengths[key];
+    }
+    for (; i < count; ++i) {
+        const size_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        values[i] = LoadValue(data, length);
+        data += length;
+    }
+    return data;
+}
+
+#endif
+
+DecodeFunction SelectDecoder() {
+#ifdef POSTING_CODEC_X86
+    if (HasSsse3()) {
+        GetShuffleTables();
+        return DecodeSsse3;
+    }
+#endif
+    return DecodeScalar;
+}
+
+DecodeFunction GetDecoder() {
+    static const DecodeFunction decoder = SelectDecoder();
+    return decoder;
+}
+
+} // namespace
+
+size_t StreamVByteMaxBytes(size_t count) {
+    return (count + 3) / 4 + 4 * count;
+}
+
+void EncodeStreamVByte(const uint32_t* values, size_t count,
+                       std::vector<uint8_t>& out) {
+    const size_t control_begin = out.size();
+    out.resize(control_begin + (count + 3) / 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = ByteLength(values[i]);
+        out[control_begin + i / 4] |=
+            static_cast<uint8_t>((length - 1) << (2 * (i % 4)));
+        for (size_t byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count,
+                                 uint32_t* values) {
+    return GetDecoder()(in, count, values);
+}
+
+void DecodeGaps(uint32_t* values, size_t count, uint32_t base) {
+    size_t i = 0;
+#ifdef POSTING_CODEC_X86
+    // SSE2 is part of every x86-64 CPU: an in-register prefix sum over
+    // four gaps at a time.
+    const __m128i ones = _mm_set1_epi32(1);
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    for (; i + 4 <= count; i += 4) {
+        __m128i sums = _mm_add_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)),
+            ones);
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+        sums = _mm_add_epi32(sums, previous);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), sums);
+        previous = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    if (i > 0) {
+        base = values[i - 1];
+    }
+#endif
+    for (; i < count; ++i) {
+        base += values[i] + 1;
+        values[i] = base;
+    }
+}
+
+const char* StreamVByteKernelName() {
+#ifdef POSTING_CODEC_X86
+    if (GetDecoder() == DecodeSsse3) {
+        return "ssse3";
+    }
+#endif
+    return "scalar";
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stream VByte integer coding used for posting blocks: one control
+// byte holds the 1..4 byte lengths of four values, controls come first
+// and the value bytes follow them. Decoding picks an SSSE3 shuffle
+// kernel at runtime when the CPU has it and scalar code otherwise.
+
+size_t StreamVByteMaxBytes(size_t count);
+
+// Appends count values to out.
+void EncodeStreamVByte(const uint32_t* values, size_t count,
+                       std::vector<uint8_t>& out);
+
+// Decodes count values from in, returns the position past the block.
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count,
+                                 uint32_t* values);
+
+// Turns gaps into ascending values in place:
+// values[i] = values[i - 1] + gaps[i] + 1, with values[-1] = base.
+void DecodeGaps(uint32_t* values, size_t count, uint32_t base);
+
+// Name of the decoding kernel picked for this CPU.
+const char* StreamVByteKernelName();
@@ -0,0 +1,251 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+#include "sorted_set.h"
+
+#include <algorithm>
+
+void PostingList::Add(int index, uint32_t count, double term_freq) {
+    tail_indexes_.push_back(index);
+    tail_counts_.push_back(count);
+    ++size_;
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+
+    if (tail_indexes_.size() == BLOCK_SIZE) {
+        MakeOwned();
+        std::array<uint32_t, BLOCK_SIZE> indexes;
+        std::copy(tail_indexes_.begin(), tail_indexes_.end(),
+                  indexes.begin());
+        blocks_.push_back({ tail_indexes_.front(), tail_indexes_.back(),
+                            static_cast<uint32_t>(data_.size()),
+                            static_cast<uint32_t>(BLOCK_SIZE) });
+        EncodeBlock(indexes.data(), tail_counts_.data(), BLOCK_SIZE,
+                    data_);
+        tail_indexes_.clear();
+        tail_counts_.clear();
+    }
+}
+
+bool PostingList::Contains(int index) const {
+    if (!tail_indexes_.empty() && tail_indexes_.front() <= index) {
+        return std::binary_search(tail_indexes_.begin(),
+                                  tail_indexes_.end(), index);
+    }
+
+    const size_t block = FindBlock(index);
+    if (block == BlockCount() || Blocks()[block].first_index > index) {
+        return false;
+    }
+    std::array<uint32_t, BLOCK_SIZE> indexes;
+    DecodeBlock(block, indexes.data(), nullptr);
+    const size_t pos = LowerBoundSorted(indexes.data(),
+                                        Blocks()[block].size, index);
+    return indexes[pos] == static_cast<uint32_t>(index);
+}
+
+void PostingList::MarkRemoved() {
+    ++removed_size_;
+}
+
+size_t PostingList::Size() const {
+    return size_;
+}
+
+size_t PostingList::LiveSize() const {
+    return size_ - removed_size_;
+}
+
+double PostingList::MaxTermFreq() const {
+    return max_term_freq_;
+}
+
+PostingList::Storage PostingList::GetStorage() const {
+    return { Blocks(), BlockCount(), Data(), DataSize(),
+             tail_indexes_.data(), tail_counts_.data(),
+             tail_indexes_.size(), size_, removed_size_, max_term_freq_ };
+}
+
+PostingList PostingList::FromStorage(const Storage& storage) {
+    PostingList postings;
+    postings.is_borrowed_ = true;
+    postings.borrowed_blocks_ = storage.blocks;
+    postings.borrowed_block_count_ = storage.block_count;
+    postings.borrowed_data_ = storage.data;
+    postings.borrowed_data_size_ = storage.data_size;
+    postings.tail_indexes_.assign(storage.tail_indexes,
+                                  storage.tail_indexes + storage.tail_size);
+    postings.tail_counts_.assign(storage.tail_counts,
+                                 storage.tail_counts + storage.tail_size);
+    postings.size_ = storage.size;
+    postings.removed_size_ = storage.removed_size;
+    postings.max_term_freq_ = storage.max_term_freq;
+    return postings;
+}
+
+bool PostingList::IsValidStorage(const Storage& storage,
+                                 size_t index_count) {
+    size_t size = storage.tail_size;
+    int64_t last_index = -1;
+    for (size_t block = 0; block < storage.block_count; ++block) {
+        const Block& header = storage.blocks[block];
+        if (header.size == 0 || header.size > BLOCK_SIZE
+            || header.first_index <= last_index
+            || header.first_index > header.last_index
+            || static_cast<size_t>(header.last_index) >= index_count
+            || header.offset >= storage.data_size
+            || (block > 0
+                && header.offset <= storage.blocks[block - 1].offset)) {
+            return false;
+        }
+        last_index = header.last_index;
+        size += header.size;
+    }
+    for (size_t i = 0; i < storage.tail_size; ++i) {
+        const int index = storage.tail_indexes[i];
+        if (index <= last_index
+            || static_cast<size_t>(index) >= index_count) {
+            return false;
+        }
+        last_index = index;
+    }
+    return size == storage.size && storage.removed_size <= size;
+}
+
+void PostingList::Intersect(std::pmr::vector<uint32_t>& indexes) const {
+    Filter(indexes, IntersectSorted);
+}
+
+void PostingList::Subtract(std::pmr::vector<uint32_t>& indexes) const {
+    Filter(indexes, SubtractSorted);
+}
+
+// PRIVATE
+
+void PostingList::MakeOwned() {
+    if (!is_borrowed_) {
+        return;
+    }
+    blocks_.assign(borrowed_blocks_,
+                   borrowed_blocks_ + borrowed_block_count_);
+    data_.assign(borrowed_data_, borrowed_data_ + borrowed_data_size_);
+    is_borrowed_ = false;
+    borrowed_blocks_ = nullptr;
+    borrowed_block_count_ = 0;
+    borrowed_data_ = nullptr;
+    borrowed_data_size_ = 0;
+}
+
+void PostingList::EncodeBlock(const uint32_t* indexes,
+                              const uint32_t* counts,
+                              size_t size,
+                              std::vector<uint8_t>& out) {
+    std::array<uint32_t, BLOCK_SIZE> values{};
+    uint32_t previous = indexes[0] - 1;
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = indexes[i] - previous - 1;
+        previous = indexes[i];
+    }
+    EncodeStreamVByte(values.data(), size, out);
+
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = counts[i] - 1;
+    }
+    EncodeStreamVByte(values.data(), size, out);
+}
+
+void PostingList::DecodeBlock(size_t block, uint32_t* indexes,
+                              uint32_t* counts) const {
+    const Block& header = Blocks()[block];
+    const uint8_t* in = DecodeStreamVByte(Data() + header.offset,
+                                          header.size, indexes);
+    DecodeGaps(indexes, header.size,
+               static_cast<uint32_t>(header.first_index) - 1);
+    if (counts != nullptr) {
+        DecodeStreamVByte(in, header.size, counts);
+        for (size_t i = 0; i < header.size; ++i) {
+            ++counts[i];
+        }
+    }
+}
+
+size_t PostingList::FindBlock(int index, size_t first) const {
+    const Block* blocks = Blocks();
+    return std::partition_point(blocks + first, blocks + BlockCount(),
+                                [index](const Block& block) {
+                                    return block.last_index < index;
+                                })
+           - blocks;
+}
+
+template <typename SetOperation>
+void PostingList::Filter(std::pmr::vector<uint32_t>& indexes,
+                         SetOperation operation) const {
+    std::pmr::vector<uint32_t> result(indexes.size(),
+                                      indexes.get_allocator());
+    std::array<uint32_t, BLOCK_SIZE> block_indexes;
+    size_t count = 0;
+    size_t block = 0;
+    auto it = indexes.begin();
+    while (it != indexes.end()) {
+        block = FindBlock(*it, block);
+        const uint32_t* values = block_indexes.data();
+        size_t size = 0;
+        auto last = indexes.end();
+        if (block < BlockCount()) {
+            DecodeBlock(block, block_indexes.data(), nullptr);
+            size = Blocks()[block].size;
+            last = std::upper_bound(it, indexes.end(),
+                       static_cast<uint32_t>(Blocks()[block].last_index));
+        } else {
+            values = reinterpret_cast<const uint32_t*>(
+                     tail_indexes_.data());
+            size = tail_indexes_.size();
+        }
+        count += operation(&*it, last - it, values, size,
+                           result.data() + count);
+        it = last;
+    }
+    result.resize(count);
+    indexes.swap(result);
+}
+
+// Cursor
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings)
+{
+    Load(0);
+}
+
+void PostingList::Cursor::NextGEQ(int target) {
+    if (IsEnd() || Index() >= target) {
+        return;
+    }
+    if (static_cast<int>(indexes_[size_ - 1]) < target) {
+        if (block_ == postings_->BlockCount()) {
+            pos_ = size_;
+            return;
+        }
+        Load(postings_->FindBlock(target, block_ + 1));
+        if (IsEnd() || static_cast<int>(indexes_[size_ - 1]) < target) {
+            pos_ = size_;
+            return;
+        }
+    }
+    pos_ += LowerBoundSorted(indexes_.data() + pos_, size_ - pos_,
+                             target);
+}
+
+void PostingList::Cursor::Load(size_t block) {
+    block_ = block;
+    pos_ = 0;
+    if (block < postings_->BlockCount()) {
+        size_ = postings_->Blocks()[block].size;
+        postings_->DecodeBlock(block, indexes_.data(), counts_.data());
+    } else {
+        size_ = postings_->tail_indexes_.size();
+        std::copy(postings_->tail_indexes_.begin(),
+                  postings_->tail_indexes_.end(), indexes_.begin());
+        std::copy(postings_->tail_counts_.begin(),
+                  postings_->tail_counts_.end(), counts_.begin());
+    }
+}
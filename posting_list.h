@@ -0,0 +1,229 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// Postings of a single term sorted by document index. Full blocks of
+// BLOCK_SIZE postings are stored compressed: index gaps and occurrence
+// counts, each coded with Stream VByte (see posting_codec.h). The
+// newest postings wait in an uncompressed tail until a block fills.
+// The block headers keep the first and the last index of every block
+// and serve as skip pointers: lookups and cursors jump over the blocks
+// that cannot hold the index they look for without decoding them.
+class PostingList {
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    class Cursor;
+
+    // Indexes must be added in increasing order. term_freq only feeds
+    // the score bound of MaxTermFreq.
+    void Add(int index, uint32_t count, double term_freq);
+
+    // Postings of removed documents stay in the list until EraseIf drops
+    // them, the list only counts them so that LiveSize is exact.
+    void MarkRemoved();
+
+    // Drops the postings whose index satisfies is_removed, which has to
+    // hold for exactly the postings counted by MarkRemoved.
+    template <typename Predicate>
+    void EraseIf(Predicate is_removed);
+
+    bool Contains(int index) const;
+
+    size_t Size() const;
+
+    size_t LiveSize() const;
+
+// Upper bound of the term frequencies in the list. EraseIf keeps it, so
+// it may exceed the current maximum.
+    double MaxTermFreq() const;
+
+    // Calls function(index, count) for every posting with
+    // first <= index < last, decoding only the blocks that overlap.
+    template <typename Function>
+    void ForEachInRange(int first, int last, Function function) const;
+
+    // Keep the sorted indexes that are in the list, or that are not in
+    // it. Only the blocks the indexes fall into are decoded, so the cost
+    // follows the shorter of the two sets. The filtered copy is taken
+    // from the allocator of indexes.
+    void Intersect(std::pmr::vector<uint32_t>& indexes) const;
+
+    void Subtract(std::pmr::vector<uint32_t>& indexes) const;
+
+    // Header of a compressed block, offset is into the list bytes.
+    struct Block {
+        int first_index;
+        int last_index;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // The parts of a list as a snapshot stores them.
+    struct Storage {
+        const Block* blocks = nullptr;
+        size_t block_count = 0;
+        const uint8_t* data = nullptr;
+        size_t data_size = 0;
+        const int* tail_indexes = nullptr;
+        const uint32_t* tail_counts = nullptr;
+        size_t tail_size = 0;
+        size_t size = 0;
+        size_t removed_size = 0;
+        double max_term_freq = 0.0;
+    };
+
+    Storage GetStorage() const;
+
+    // The blocks and their bytes are read in place and must outlive the
+    // list, the tail is copied. The first change to a block copies them
+    // all into the list.
+    static PostingList FromStorage(const Storage& storage);
+
+    // Checks what a list needs from its block headers and tail before
+    // FromStorage: blocks of 1 to BLOCK_SIZE postings in increasing
+    // order at increasing offsets, indexes in [0, index_count) and sizes
+    // that add up. The block bytes are not decoded.
+    static bool IsValidStorage(const Storage& storage, size_t index_count);
+
+private:
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> data_;
+    std::vector<int> tail_indexes_;
+    std::vector<uint32_t> tail_counts_;
+    size_t size_ = 0;
+    size_t removed_size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    // Blocks of a list made by FromStorage, used instead of blocks_ and
+    // data_ while is_borrowed_ is set.
+    bool is_borrowed_ = false;
+    const Block* borrowed_blocks_ = nullptr;
+    size_t borrowed_block_count_ = 0;
+    const uint8_t* borrowed_data_ = nullptr;
+    size_t borrowed_data_size_ = 0;
+
+    const Block* Blocks() const {
+        return is_borrowed_ ? borrowed_blocks_ : blocks_.data();
+    }
+
+    size_t BlockCount() const {
+        return is_borrowed_ ? borrowed_block_count_ : blocks_.size();
+    }
+
+    const uint8_t* Data() const {
+        return is_borrowed_ ? borrowed_data_ : data_.data();
+    }
+
+    size_t DataSize() const {
+        return is_borrowed_ ? borrowed_data_size_ : data_.size();
+    }
+
+    // Copies borrowed blocks into blocks_ and data_.
+    void MakeOwned();
+
+    static void EncodeBlock(const uint32_t* indexes,
+                            const uint32_t* counts,
+                            size_t size,
+                            std::vector<uint8_t>& out);
+
+    // Decodes block number block; counts may be nullptr.
+    void DecodeBlock(size_t block, uint32_t* indexes,
+                     uint32_t* counts) const;
+
+    // First block from first on whose last index is not less than index.
+    size_t FindBlock(int index, size_t first = 0) const;
+
+    // Applies operation(a, a_size, b, b_size, out), one of the
+    // sorted_set.h functions, to the indexes block by block.
+    template <typename SetOperation>
+    void Filter(std::pmr::vector<uint32_t>& indexes,
+                SetOperation operation) const;
+};
+
+// Sequential reader over a posting list that decodes one block at a
+// time.
+class PostingList::Cursor {
+public:
+    explicit Cursor(const PostingList& postings);
+
+    // The per-posting calls are defined inline, the scoring loops make
+    // them for every posting they visit.
+    bool IsEnd() const {
+        return pos_ == size_;
+    }
+
+    int Index() const {
+        return indexes_[pos_];
+    }
+
+    uint32_t Count() const {
+        return counts_[pos_];
+    }
+
+    void Next() {
+        if (++pos_ == size_ && block_ < postings_->BlockCount()) {
+            Load(block_ + 1);
+        }
+    }
+
+    // Moves to the first posting with index >= target. Blocks ending
+    // before target are skipped by their headers, the position inside
+    // the block is found with LowerBoundSorted.
+    void NextGEQ(int target);
+
+private:
+    const PostingList* postings_;
+    size_t block_ = 0;
+    size_t pos_ = 0;
+    size_t size_ = 0;
+    std::array<uint32_t, BLOCK_SIZE> indexes_;
+    std::array<uint32_t, BLOCK_SIZE> counts_;
+
+    void Load(size_t block);
+};
+
+template <typename Function>
+void PostingList::ForEachInRange(int first, int last,
+                                 Function function) const {
+    std::array<uint32_t, BLOCK_SIZE> indexes;
+    std::array<uint32_t, BLOCK_SIZE> counts;
+    const Block* blocks = Blocks();
+    for (size_t block = FindBlock(first);
+         block < BlockCount() && blocks[block].first_index < last;
+         ++block) {
+        DecodeBlock(block, indexes.data(), counts.data());
+        for (size_t i = 0; i < blocks[block].size; ++i) {
+            const int index = indexes[i];
+            if (index >= first && index < last) {
+                function(index, counts[i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < tail_indexes_.size(); ++i) {
+        if (tail_indexes_[i] >= first && tail_indexes_[i] < last) {
+            function(tail_indexes_[i], tail_counts_[i]);
+        }
+    }
+}
+
+// Rebuilds the list from the kept postings. The score bound is kept as
+// it is, it still holds for what remains.
+template <typename Predicate>
+void PostingList::EraseIf(Predicate is_removed) {
+    PostingList kept;
+    ForEachInRange(0, std::numeric_limits<int>::max(),
+        [&kept, &is_removed](int index, uint32_t count) {
+            if (!is_removed(index)) {
+                kept.Add(index, count, 0.0);
+            }
+        });
+    kept.max_term_freq_ = kept.size_ == 0 ? 0.0 : max_term_freq_;
+    *this = std::move(kept);
+}
@@ -0,0 +1,77 @@
+#include "query_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+// PUBLIC
+
+// Small caches get fewer shards, so that each shard still holds a
+// useful number of entries.
+QueryCache::QueryCache(size_t capacity)
+    : shards_(std::clamp<size_t>(capacity / 64, 1,
+              std::max(4u, 4 * std::thread::hardware_concurrency())))
+{
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i].capacity = capacity / shards_.size()
+                              + (i < capacity % shards_.size() ? 1 : 0);
+    }
+}
+
+// A stale entry is dropped at once, the query is going to be computed
+// again and inserted at the new generation anyway.
+std::optional<std::vector<Document>>
+QueryCache::Find(const std::string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it == shard.positions.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    const auto entry = it->second;
+    if (entry->generation != generation) {
+        shard.positions.erase(it);
+        shard.entries.erase(entry);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return entry->documents;
+}
+
+void QueryCache::Insert(const std::string& key, uint64_t generation,
+                        const std::vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    if (shard.capacity == 0) {
+        return;
+    }
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it != shard.positions.end()) {
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries,
+                             it->second);
+        return;
+    }
+    if (shard.entries.size() == shard.capacity) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front(Entry{ key, generation, documents });
+    shard.positions.emplace(shard.entries.front().key,
+                            shard.entries.begin());
+}
+
+QueryCacheStatistics QueryCache::GetStatistics() const {
+    return { hits_.load(std::memory_order_relaxed),
+             misses_.load(std::memory_order_relaxed) };
+}
+
+// PRIVATE
+
+QueryCache::Shard& QueryCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStatistics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Size-bounded LRU cache of query results, see
+// SearchServer::SetQueryCache. An entry remembers the index generation
+// it was computed for and only hits while the index is still at that
+// generation. The keys are striped over independently locked shards,
+// each with its own LRU order, so concurrent queries rarely meet on a
+// lock.
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity);
+
+    std::optional<std::vector<Document>> Find(const std::string& key,
+                                              uint64_t generation);
+
+    void Insert(const std::string& key, uint64_t generation,
+                const std::vector<Document>& documents);
+
+    QueryCacheStatistics GetStatistics() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    // Most recently used entries first; positions is keyed by views
+    // into the keys of entries.
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view,
+                           std::list<Entry>::iterator> positions;
+        size_t capacity = 0;
+    };
+
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard& GetShard(const std::string& key);
+};
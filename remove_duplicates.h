@@ -9,3 +9,17 @@ void RemoveDuplicates(SearchServer& search_server) {
         search_server.RemoveDocument(id);
     }
 }
+
+// Keeps the first document of every group of near-duplicates.
+void RemoveDuplicates(SearchServer& search_server, double threshold) {
+    std::vector<int> duplicates;
+    for (const auto& group : search_server.GetNearDuplicates(threshold)) {
+        duplicates.insert(duplicates.end(), group.begin() + 1, group.end());
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    for (const auto id : duplicates) {
+        std::cout << "Found duplicate document id "s
+                  << id << std::endl;
+        search_server.RemoveDocument(id);
+    }
+}
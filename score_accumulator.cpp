@@ -0,0 +1,24 @@
+#include "score_accumulator.h"
+
+void ScoreAccumulator::Reserve(size_t document_count) {
+    if (scores_.size() < document_count) {
+        scores_.resize(document_count, 0.0);
+        states_.resize(document_count, State::UNTOUCHED);
+    }
+}
+
+void ScoreAccumulator::Add(int index, double score) {
+    if (states_[index] == State::UNTOUCHED) {
+        states_[index] = State::SCORED;
+        touched_.push_back(index);
+    }
+    scores_[index] += score;
+}
+
+void ScoreAccumulator::Clear() {
+    for (const int index : touched_) {
+        scores_[index] = 0.0;
+        states_[index] = State::UNTOUCHED;
+    }
+    touched_.clear();
+}
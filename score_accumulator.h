@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Relevance accumulator over dense internal document ids. Only the
+// touched entries are remembered, so Clear costs O(touched) and one
+// accumulator can be reused by every query of a thread.
+class ScoreAccumulator {
+public:
+    void Reserve(size_t document_count);
+
+    void Add(int index, double score);
+
+    // Touched ids in the order they were first touched.
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    void Clear();
+
+private:
+    enum class State : char {
+        UNTOUCHED,
+        SCORED
+    };
+
+    std::vector<double> scores_;
+    std::vector<State> states_;
+    std::vector<int> touched_;
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEach(Function function) const {
+    for (const int index : touched_) {
+        function(index, scores_[index]);
+    }
+}
@@ -1,4 +1,5 @@
 #include "search_server.h"
+#include "posting_codec.h"
 
 // PUBLIC
 
@@ -7,164 +8,798 @@ void SearchServer::AddDocument(int document_id,
                    DocumentStatus status,
                    const std::vector<int>& ratings) {
     if ((document_id < 0) ||
-        (documents_.count(document_id) > 0)) {
+        (document_indexes_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
 
     const auto words = SplitIntoWordsNoStop(document);
     const double inv_word_count = 1.0 / words.size();
 
+    // Sorted ids, the equal ones are counted as runs.
+    std::vector<uint32_t> terms;
+    terms.reserve(words.size());
     for (const auto word : words) {
-        auto it = words_.insert(std::string(word));
-        std::string_view sv_word = *(it.first);
-        word_to_document_freqs_[sv_word][document_id]
-            += inv_word_count;
-        document_to_word_freqs_[document_id][sv_word]
-            += inv_word_count;
+        terms.push_back(terms_.Intern(word));
     }
+    term_postings_.resize(terms_.Size());
+    ExtendTermFingerprints();
+    std::sort(terms.begin(), terms.end());
 
-    documents_.emplace(document_id,
-                       DocumentData
-                       {ComputeAverageRating(ratings), status});
+    const int index = documents_.size();
+    const DocumentData& document_data =
+        documents_.emplace_back(DocumentData{
+            document_id, ComputeAverageRating(ratings), status,
+            inv_word_count });
+    ExtendLogCounts();
+    size_t term_count = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        term_count += i == 0 || terms[i] != terms[i - 1];
+    }
+    auto& term_freqs = document_to_term_freqs_.emplace_back();
+    term_freqs.reserve(term_count);
+    for (size_t begin = 0, end = 0; begin < terms.size(); begin = end) {
+        while (end < terms.size() && terms[end] == terms[begin]) {
+            ++end;
+        }
+        const uint32_t count = end - begin;
+        const double term_freq = ComputeTermFreq(count, document_data);
+        term_freqs.emplace_back(terms[begin], term_freq);
+        term_postings_[terms[begin]].Add(index, count, term_freq);
+    }
+    min_hashes_.resize(documents_.size() * MIN_HASH_SIZE);
+    ComputeMinHash(index, term_freqs);
+    document_fingerprints_.push_back(ComputeFingerprint(term_freqs));
 
+    document_indexes_.emplace(document_id, index);
     document_ids_.emplace(document_id);
+    AddFingerprint(index);
+    posting_count_ += term_freqs.size();
+    generation_ = NextGeneration();
+
+    LogAddDocument(document_id, document, status, ratings);
+}
+
+// AddDocuments
+// The batch is cut into one slice per thread and loaded in four passes:
+// 1. every slice is tokenized and inverted by its own task, each word
+//    of the slice gets a local number from the interner of the slice
+//    and a list of (index, count);
+// 2. the vocabularies of the slices are sorted together in parallel and
+//    cut into runs of one word; the runs are sorted by where the batch
+//    first meets their word and interned in that order, so every word
+//    gets the term id AddDocument would give it;
+// 3. the lists of equal words are appended to the index, one task per
+//    range of words; slices are taken in batch order, so every posting
+//    list receives its indexes in the order AddDocument would give them;
+// 4. the forward index, the MinHash signatures and the fingerprints
+//    are filled by slice again.
+// Only the first pass can fail on the input and it changes nothing.
+void SearchServer::AddDocuments(
+                   const std::vector<DocumentInput>& documents) {
+    std::unordered_set<int> batch_ids;
+    for (const DocumentInput& document : documents) {
+        if ((document.id < 0) ||
+            (document_indexes_.count(document.id) > 0) ||
+            !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Invalid document_id");
+        }
+    }
+    if (documents.empty()) {
+        return;
+    }
+
+    const int first_index = documents_.size();
+    const int document_count = documents.size();
+    const int thread_count = std::max(1u,
+                                      std::thread::hardware_concurrency());
+    std::vector<BatchSlice> slices(std::min(document_count, thread_count));
+    const int slice_count = slices.size();
+    for (int i = 0; i < slice_count; ++i) {
+        slices[i].first = int64_t{document_count} * i / slice_count;
+        slices[i].last = int64_t{document_count} * (i + 1) / slice_count;
+    }
+
+    std::vector<DocumentData> batch_data(document_count);
+    for_each (std::execution::par,
+              slices.begin(), slices.end(),
+              [this, &documents, &batch_data,
+               first_index](BatchSlice& slice) {
+                  try {
+                      InvertBatchSlice(documents, first_index,
+                                       batch_data, slice);
+                  } catch (...) {
+                      slice.error = std::current_exception();
+                  }
+              });
+    for (const BatchSlice& slice : slices) {
+        if (slice.error) {
+            std::rethrow_exception(slice.error);
+        }
+    }
+
+    // (word, slice, local number) of every slice vocabulary entry, the
+    // entries of one word end up adjacent and in slice order.
+    std::vector<std::tuple<std::string_view, int, uint32_t>> vocabulary;
+    for (int i = 0; i < slice_count; ++i) {
+        for (uint32_t number = 0; number < slices[i].words.Size();
+             ++number) {
+            vocabulary.emplace_back(slices[i].words.GetTerm(number), i,
+                                    number);
+        }
+    }
+    std::sort(std::execution::par, vocabulary.begin(), vocabulary.end());
+
+    // [begin, end) of the entries of every word. The first entry is
+    // where the batch first meets the word, so sorting the runs by it
+    // interns the words in the order AddDocument would.
+    std::vector<std::pair<size_t, size_t>> word_runs;
+    for (size_t i = 0; i < vocabulary.size(); ++i) {
+        if (i == 0 || std::get<0>(vocabulary[i - 1])
+                      != std::get<0>(vocabulary[i])) {
+            word_runs.emplace_back(i, i);
+        }
+        word_runs.back().second = i + 1;
+    }
+    std::sort(std::execution::par, word_runs.begin(), word_runs.end(),
+              [&vocabulary](const auto& lhs, const auto& rhs) {
+                  const auto& [_, lhs_slice, lhs_number] =
+                      vocabulary[lhs.first];
+                  const auto& [__, rhs_slice, rhs_number] =
+                      vocabulary[rhs.first];
+                  return std::tie(lhs_slice, lhs_number)
+                         < std::tie(rhs_slice, rhs_number);
+              });
+    std::vector<uint32_t> run_terms(word_runs.size());
+    for (size_t run = 0; run < word_runs.size(); ++run) {
+        run_terms[run] = terms_.Intern(
+            std::get<0>(vocabulary[word_runs[run].first]));
+    }
+    term_postings_.resize(terms_.Size());
+    ExtendTermFingerprints();
+    documents_.insert(documents_.end(),
+                      batch_data.begin(), batch_data.end());
+    ExtendLogCounts();
+
+    for (BatchSlice& slice : slices) {
+        slice.terms.resize(slice.words.Size());
+    }
+    const int part_count = std::clamp<int>(word_runs.size(), 1,
+                                           4 * thread_count);
+    std::vector<int> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    for_each (std::execution::par,
+              parts.begin(), parts.end(),
+              [this, &slices, &vocabulary, &word_runs, &run_terms,
+               part_count](int part) {
+                  const size_t first = word_runs.size() * part / part_count;
+                  const size_t last = word_runs.size() * (part + 1)
+                                      / part_count;
+                  for (size_t run = first; run < last; ++run) {
+                      PostingList& postings = term_postings_[run_terms[run]];
+                      for (size_t i = word_runs[run].first;
+                           i < word_runs[run].second; ++i) {
+                          const auto [_, slice, number] = vocabulary[i];
+                          slices[slice].terms[number] = run_terms[run];
+                          for (const auto& [index, count] :
+                               slices[slice].postings[number]) {
+                              postings.Add(index, count,
+                                  ComputeTermFreq(count,
+                                                  documents_[index]));
+                          }
+                      }
+                  }
+              });
+
+    document_to_term_freqs_.resize(first_index + document_count);
+    min_hashes_.resize(documents_.size() * MIN_HASH_SIZE);
+    document_fingerprints_.resize(documents_.size());
+    for_each (std::execution::par,
+              slices.begin(), slices.end(),
+              [this, first_index](const BatchSlice& slice) {
+                  for (int i = slice.first; i < slice.last; ++i) {
+                      const int index = first_index + i;
+                      const size_t begin =
+                          slice.document_offsets[i - slice.first];
+                      const size_t end =
+                          slice.document_offsets[i - slice.first + 1];
+                      auto& term_freqs = document_to_term_freqs_[index];
+                      term_freqs.reserve(end - begin);
+                      for (size_t j = begin; j < end; ++j) {
+                          const auto [number, count] =
+                              slice.document_words[j];
+                          term_freqs.emplace_back(slice.terms[number],
+                              ComputeTermFreq(count, documents_[index]));
+                      }
+                      // Already sorted where the slice met its words in
+                      // term id order, e.g. in the first slice.
+                      if (!std::is_sorted(term_freqs.begin(),
+                                          term_freqs.end())) {
+                          std::sort(term_freqs.begin(), term_freqs.end());
+                      }
+                      ComputeMinHash(index, term_freqs);
+                      document_fingerprints_[index] =
+                          ComputeFingerprint(term_freqs);
+                  }
+              });
+
+    for (int i = 0; i < document_count; ++i) {
+        document_indexes_.emplace(documents[i].id, first_index + i);
+        document_ids_.emplace(documents[i].id);
+        AddFingerprint(first_index + i);
+    }
+    for (const BatchSlice& slice : slices) {
+        posting_count_ += slice.document_words.size();
+    }
+    generation_ = NextGeneration();
+
+    if (log_.log) {
+        uint64_t sequence_number = 0;
+        for (const DocumentInput& document : documents) {
+            sequence_number = log_.log->AppendAddDocument(
+                              document.id, document.text,
+                              document.status, document.ratings);
+        }
+        CommitToLog(sequence_number);
+    }
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ids_.size();
 }
 
-std::set<int>::const_iterator SearchServer::begin() const {
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
+std::pmr::set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
+// Duplicates
 std::list<int> 
 SearchServer::GetDuplicates() const {
-    std::list<int> result;
-    std::set<std::list<std::string_view>> bunch_of_words;
-    for (const auto& [id, words] : document_to_word_freqs_) {
-        std::list<std::string_view> key(words.size());
-        std::transform(words.begin(), words.end(),
-                       key.begin(),
-                       [](const auto& value) {
-                           return value.first;
+    return { duplicate_ids_.begin(), duplicate_ids_.end() };
+}
+
+bool SearchServer::IsDuplicate(int document_id) const {
+    return duplicate_ids_.count(document_id) > 0;
+}
+
+// A word the vocabulary lacks is in no document.
+std::optional<int>
+SearchServer::FindDuplicate(const std::string_view document) const {
+    auto words = SplitIntoWordsNoStop(document);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty()) {
+        return std::nullopt;
+    }
+    Fingerprint fingerprint;
+    for (const std::string_view word : words) {
+        const uint32_t term = terms_.Find(word);
+        if (term == TermInterner::NO_TERM) {
+            return std::nullopt;
+        }
+        fingerprint += term_fingerprints_[term];
+    }
+    const auto it = fingerprint_to_first_id_.find(fingerprint);
+    if (it == fingerprint_to_first_id_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+// Near-duplicates
+// Every band sorts the keys (band hash, term count, position) of the
+// live documents with words, documents with equal band hashes are
+// candidates. A member of a large group is only paired with the
+// MAX_LSH_BUCKET_NEIGHBORS before it, which the term count keeps to the
+// documents of the closest sizes; the pairs still chain the group into
+// one. Candidates are checked in parallel and joined by union-find.
+std::vector<std::vector<int>>
+SearchServer::GetNearDuplicates(double threshold) const {
+    if (!(threshold > 0.0 && threshold <= 1.0)) {
+        throw std::invalid_argument("Invalid similarity threshold"s);
+    }
+
+    std::vector<int> indexes;
+    std::vector<const TermFreqs*> term_freqs;
+    indexes.reserve(document_ids_.size());
+    term_freqs.reserve(document_ids_.size());
+    for (int index = 0; index < static_cast<int>(documents_.size());
+         ++index) {
+        if (documents_[index].is_removed) {
+            continue;
+        }
+        const TermFreqs& document_term_freqs = GetDocumentTermFreqs(index);
+        if (!document_term_freqs.empty()) {
+            indexes.push_back(index);
+            term_freqs.push_back(&document_term_freqs);
+        }
+    }
+    const int document_count = indexes.size();
+    std::vector<int> positions(document_count);
+    std::iota(positions.begin(), positions.end(), 0);
+
+    const LshBands bands = ChooseLshBands(threshold);
+    std::vector<std::tuple<uint64_t, size_t, int>> keys(document_count);
+    std::vector<std::pair<int, int>> candidates;
+    for (size_t band = 0; band < bands.band_count; ++band) {
+        std::transform(std::execution::par,
+                       positions.begin(), positions.end(), keys.begin(),
+                       [this, &indexes, &term_freqs, &bands,
+                        band](int position) {
+                           const uint32_t* values = min_hashes_.data()
+                               + indexes[position] * MIN_HASH_SIZE
+                               + band * bands.band_size;
+                           return std::make_tuple(
+                                  HashLshBand(values, bands.band_size),
+                                  term_freqs[position]->size(), position);
                        });
-        if (bunch_of_words.count(key) > 0) {
-            result.push_back(id);
-        } else {
-            bunch_of_words.insert(key);
+        std::sort(std::execution::par, keys.begin(), keys.end());
+        for (size_t begin = 0, end = 0; begin < keys.size(); begin = end) {
+            while (end < keys.size()
+                   && std::get<0>(keys[end]) == std::get<0>(keys[begin])) {
+                ++end;
+            }
+            for (size_t i = begin + 1; i < end; ++i) {
+                const size_t first = i - std::min(i - begin,
+                                                  MAX_LSH_BUCKET_NEIGHBORS);
+                for (size_t j = first; j < i; ++j) {
+                    candidates.push_back(std::minmax(std::get<2>(keys[j]),
+                                                     std::get<2>(keys[i])));
+                }
+            }
         }
     }
-    return result;
+    std::sort(std::execution::par, candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+
+    // Term ids are sorted, the intersection is one merge.
+    std::vector<char> is_similar(candidates.size());
+    std::transform(std::execution::par,
+                   candidates.begin(), candidates.end(), is_similar.begin(),
+                   [&term_freqs, threshold](std::pair<int, int> candidate) {
+                       const TermFreqs& lhs = *term_freqs[candidate.first];
+                       const TermFreqs& rhs = *term_freqs[candidate.second];
+                       const size_t min_size = std::min(lhs.size(),
+                                                        rhs.size());
+                       const size_t max_size = std::max(lhs.size(),
+                                                        rhs.size());
+                       if (min_size < threshold * max_size - MIN_REAL_VALUE) {
+                           return false;
+                       }
+                       size_t common_count = 0;
+                       for (auto l = lhs.begin(), r = rhs.begin();
+                            l != lhs.end() && r != rhs.end();) {
+                           if (l->first < r->first) {
+                               ++l;
+                           } else if (r->first < l->first) {
+                               ++r;
+                           } else {
+                               ++common_count;
+                               ++l;
+                               ++r;
+                           }
+                       }
+                       const size_t union_count = lhs.size() + rhs.size()
+                                                  - common_count;
+                       return common_count + MIN_REAL_VALUE
+                              >= threshold * union_count;
+                   });
+
+    // Every root is the smallest position of its group.
+    std::vector<int> parents(positions);
+    const auto find_root = [&parents](int position) {
+        while (parents[position] != position) {
+            parents[position] = parents[parents[position]];
+            position = parents[position];
+        }
+        return position;
+    };
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (is_similar[i]) {
+            const int lhs = find_root(candidates[i].first);
+            const int rhs = find_root(candidates[i].second);
+            parents[std::max(lhs, rhs)] = std::min(lhs, rhs);
+        }
+    }
+
+    std::vector<int> group_sizes(document_count);
+    for (const int position : positions) {
+        ++group_sizes[find_root(position)];
+    }
+    std::vector<int> group_numbers(document_count, -1);
+    std::vector<std::vector<int>> groups;
+    for (const int position : positions) {
+        const int root = find_root(position);
+        if (group_sizes[root] < 2) {
+            continue;
+        }
+        if (group_numbers[root] < 0) {
+            group_numbers[root] = groups.size();
+            groups.emplace_back().reserve(group_sizes[root]);
+        }
+        groups[group_numbers[root]].push_back(
+            documents_[indexes[position]].id);
+    }
+    for (auto& group : groups) {
+        std::sort(group.begin(), group.end());
+    }
+    std::sort(groups.begin(), groups.end());
+    return groups;
 }
 
-const std::map<std::string_view, double>&
-SearchServer::GetWordFrequencies(int document_id) const {
-    static std::map<std::string_view, double> result;
-    if (documents_.count(document_id) > 0) {
-        result = document_to_word_freqs_.at(document_id);
-    } else {
-        result.clear();
+// The view points at the entries, not at the vector that holds them,
+// so document_to_term_freqs_ may grow under it.
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
+        return {};
     }
-    return result;
+    const TermFreqs& term_freqs = GetDocumentTermFreqs(index);
+    return { term_freqs.data(), term_freqs.data() + term_freqs.size(),
+             &terms_ };
 }
 
-// RemoveDocument
-void SearchServer::RemoveDocument(int document_id) {
-    std::set<int>::iterator
-    it = find(document_ids_.begin(), document_ids_.end(),
-              document_id);
-    if (it == document_ids_.end()) {
-        return;
+// Snapshot
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteStrings(SnapshotSectionId::STOP_WORDS, stop_words_);
+    writer.WriteStrings(SnapshotSectionId::WORDS, terms_);
+
+    std::vector<SnapshotDocument> documents;
+    documents.reserve(documents_.size());
+    for (size_t index = 0; index < documents_.size(); ++index) {
+        const DocumentData& document_data = documents_[index];
+        documents.push_back({
+            document_data.id, document_data.rating,
+            static_cast<int32_t>(document_data.status),
+            FindDocumentIndex(document_data.id)
+                == static_cast<int>(index),
+            document_data.inv_word_count });
+    }
+    writer.BeginSection(SnapshotSectionId::DOCUMENTS);
+    writer.WriteArray(documents);
+
+    // Lists in term id order, the three shared sections are then
+    // written by walking them again.
+    std::vector<PostingList::Storage> storages;
+    std::vector<SnapshotPostingList> posting_lists;
+    SnapshotPostingList next{};
+    for (uint32_t term = 0; term < terms_.Size(); ++term) {
+        const PostingList* postings = FindPostings(term);
+        const PostingList::Storage storage =
+            postings == nullptr ? PostingList::Storage{}
+                                : postings->GetStorage();
+        storages.push_back(storage);
+        posting_lists.push_back({
+            next.first_block, storage.block_count,
+            next.data_offset, storage.data_size,
+            next.first_tail, storage.tail_size,
+            storage.size, storage.removed_size, storage.max_term_freq });
+        next.first_block += storage.block_count;
+        next.data_offset += storage.data_size;
+        next.first_tail += storage.tail_size;
+    }
+    writer.BeginSection(SnapshotSectionId::POSTING_LISTS);
+    writer.WriteArray(posting_lists);
+    writer.BeginSection(SnapshotSectionId::BLOCKS);
+    for (const auto& storage : storages) {
+        writer.Write(storage.blocks,
+                     storage.block_count * sizeof(PostingList::Block));
+    }
+    writer.BeginSection(SnapshotSectionId::BLOCK_DATA);
+    for (const auto& storage : storages) {
+        writer.Write(storage.data, storage.data_size);
+    }
+    // Whatever a damaged block says about its length, decoding it stays
+    // inside the file. The values it decodes to are only checked by the
+    // BLOCK_DATA checksum, see SnapshotVerification.
+    writer.WriteArray(std::vector<uint8_t>(
+        StreamVByteMaxBytes(PostingList::BLOCK_SIZE) * 2, 0));
+    writer.BeginSection(SnapshotSectionId::TAIL_INDEXES);
+    for (const auto& storage : storages) {
+        writer.Write(storage.tail_indexes,
+                     storage.tail_size * sizeof(int32_t));
+    }
+    writer.BeginSection(SnapshotSectionId::TAIL_COUNTS);
+    for (const auto& storage : storages) {
+        writer.Write(storage.tail_counts,
+                     storage.tail_size * sizeof(uint32_t));
     }
 
-    for (auto [word, _] : document_to_word_freqs_[document_id]) {
-        word_to_document_freqs_[word].erase(document_id);
-        if (word_to_document_freqs_[word].empty()) {
-            word_to_document_freqs_.erase(word);
+    std::vector<uint64_t> forward_offsets{ 0 };
+    std::vector<uint32_t> forward_terms;
+    std::vector<double> forward_freqs;
+    for (size_t index = 0; index < documents_.size(); ++index) {
+        for (const auto& [term, term_freq] : GetDocumentTermFreqs(index)) {
+            forward_terms.push_back(term);
+            forward_freqs.push_back(term_freq);
         }
+        forward_offsets.push_back(forward_terms.size());
     }
+    writer.BeginSection(SnapshotSectionId::FORWARD_OFFSETS);
+    writer.WriteArray(forward_offsets);
+    writer.BeginSection(SnapshotSectionId::FORWARD_WORDS);
+    writer.WriteArray(forward_terms);
+    writer.BeginSection(SnapshotSectionId::FORWARD_FREQS);
+    writer.WriteArray(forward_freqs);
+    writer.Finish(log_sequence_number_);
+}
+
+SearchServer SearchServer::LoadSnapshot(
+                           const std::string& path,
+                           SnapshotVerification verification) {
+    auto file = std::make_shared<const MappedFile>(path);
+    const SnapshotReader reader(
+        *file, verification == SnapshotVerification::FULL);
+    const auto damaged = [] {
+        return std::runtime_error("Damaged snapshot "s);
+    };
+
+    SearchServer server(
+        reader.GetStrings(SnapshotSectionId::STOP_WORDS));
+
+    // Words are stored in term id order, so interning them gives them
+    // their ids back.
+    for (const std::string_view word :
+         reader.GetStrings(SnapshotSectionId::WORDS)) {
+        if (server.terms_.Intern(word) != server.terms_.Size() - 1) {
+            throw damaged();
+        }
+    }
+    const size_t term_count = server.terms_.Size();
+    server.ExtendTermFingerprints();
+
+    const auto documents = reader.GetArray<SnapshotDocument>(
+                           SnapshotSectionId::DOCUMENTS);
+    server.documents_.reserve(documents.size);
+    for (size_t index = 0; index < documents.size; ++index) {
+        const SnapshotDocument& document = documents[index];
+        if (document.status < 0 || document.status
+            > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            throw damaged();
+        }
+        server.documents_.push_back({
+            document.id, document.rating,
+            static_cast<DocumentStatus>(document.status),
+            document.inv_word_count, !document.is_live });
+        if (document.is_live) {
+            server.document_indexes_.emplace(document.id, index);
+            server.document_ids_.emplace(document.id);
+        }
+    }
+    server.ExtendLogCounts();
 
-    document_ids_.erase(it);
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
+    const auto posting_lists = reader.GetArray<SnapshotPostingList>(
+                               SnapshotSectionId::POSTING_LISTS);
+    const auto blocks = reader.GetArray<PostingList::Block>(
+                        SnapshotSectionId::BLOCKS);
+    const auto data = reader.GetArray<uint8_t>(
+                      SnapshotSectionId::BLOCK_DATA);
+    const auto tail_indexes = reader.GetArray<int32_t>(
+                              SnapshotSectionId::TAIL_INDEXES);
+    const auto tail_counts = reader.GetArray<uint32_t>(
+                             SnapshotSectionId::TAIL_COUNTS);
+    if (posting_lists.size != term_count
+        || tail_indexes.size != tail_counts.size) {
+        throw damaged();
+    }
+    server.term_postings_.resize(term_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        const SnapshotPostingList& list = posting_lists[i];
+        if (list.size == 0) {
+            continue;
+        }
+        if (list.first_block + list.block_count > blocks.size
+            || list.data_offset + list.data_size > data.size
+            || list.first_tail + list.tail_size > tail_indexes.size
+            || list.removed_size > list.size) {
+            throw damaged();
+        }
+        PostingList::Storage storage;
+        storage.blocks = blocks.data + list.first_block;
+        storage.block_count = list.block_count;
+        storage.data = data.data + list.data_offset;
+        storage.data_size = list.data_size;
+        storage.tail_indexes = tail_indexes.data + list.first_tail;
+        storage.tail_counts = tail_counts.data + list.first_tail;
+        storage.tail_size = list.tail_size;
+        storage.size = list.size;
+        storage.removed_size = list.removed_size;
+        storage.max_term_freq = list.max_term_freq;
+        if (!PostingList::IsValidStorage(storage, documents.size)) {
+            throw damaged();
+        }
+        server.term_postings_[i] = PostingList::FromStorage(storage);
+        server.posting_count_ += list.size;
+        server.removed_posting_count_ += list.removed_size;
+    }
+
+    const auto forward_offsets = reader.GetArray<uint64_t>(
+                                 SnapshotSectionId::FORWARD_OFFSETS);
+    const auto forward_terms = reader.GetArray<uint32_t>(
+                               SnapshotSectionId::FORWARD_WORDS);
+    const auto forward_freqs = reader.GetArray<double>(
+                               SnapshotSectionId::FORWARD_FREQS);
+    if (forward_offsets.size != documents.size + 1
+        || forward_terms.size != forward_freqs.size
+        || forward_offsets[documents.size] != forward_terms.size) {
+        throw damaged();
+    }
+    for (size_t index = 0; index < documents.size; ++index) {
+        if (forward_offsets[index] > forward_offsets[index + 1]) {
+            throw damaged();
+        }
+    }
+    if (std::any_of(forward_terms.data,
+                    forward_terms.data + forward_terms.size,
+                    [term_count](uint32_t term) {
+                        return term >= term_count;
+                    })) {
+        throw damaged();
+    }
+    server.document_to_term_freqs_.resize(documents.size);
+    server.is_term_freqs_mapped_.assign(documents.size, 1);
+    server.mapped_forward_index_ = std::make_shared<MappedForwardIndex>();
+    server.mapped_forward_index_->offsets = forward_offsets;
+    server.mapped_forward_index_->terms = forward_terms;
+    server.mapped_forward_index_->freqs = forward_freqs;
+
+    // Signatures and fingerprints are not stored, the term ids are
+    // enough to take them without building the word frequencies.
+    server.min_hashes_.resize(documents.size * MIN_HASH_SIZE);
+    server.document_fingerprints_.resize(documents.size);
+    std::vector<int> indexes(documents.size);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    for_each (std::execution::par,
+              indexes.begin(), indexes.end(),
+              [&server, &forward_offsets, &forward_terms](int index) {
+                  MinHasher min_hasher;
+                  Fingerprint fingerprint;
+                  for (uint64_t i = forward_offsets[index];
+                       i < forward_offsets[index + 1]; ++i) {
+                      min_hasher.Add(forward_terms[i]);
+                      fingerprint +=
+                          server.term_fingerprints_[forward_terms[i]];
+                  }
+                  min_hasher.Finish(server.min_hashes_.data()
+                                    + index * MIN_HASH_SIZE);
+                  server.document_fingerprints_[index] = fingerprint;
+              });
+    for (const int id : server.document_ids_) {
+        server.AddFingerprint(server.document_indexes_.at(id));
+    }
+
+    server.log_sequence_number_ = reader.GetLogSequenceNumber();
+    server.snapshot_file_ = std::move(file);
+    return server;
 }
 
-// RemoveDocument sequenced_policy
-void SearchServer::RemoveDocument(
-                   const std::execution::sequenced_policy& policy,
-                   int document_id) {
-    std::set<int>::iterator
-    it = find(policy, document_ids_.begin(), document_ids_.end(),
-              document_id);
-    if (it == document_ids_.end()) {
+// Log
+void SearchServer::AttachLog(std::shared_ptr<WriteAheadLog> log,
+                             LogDurability durability) {
+    if (log == nullptr
+        || log->GetLastSequenceNumber() != log_sequence_number_) {
+        throw std::invalid_argument(
+              "Log does not match the state of the server"s);
+    }
+    log_.log = std::move(log);
+    log_.durability = durability;
+}
+
+void SearchServer::ReplayLog(const std::string& path) {
+    if (log_.log) {
+        throw std::logic_error("Log replayed after AttachLog"s);
+    }
+    LogReader reader(path);
+    LogRecord record;
+    while (reader.Next(record)) {
+        if (record.sequence_number <= log_sequence_number_) {
+            continue;
+        }
+        if (record.type == LogRecordType::ADD_DOCUMENT) {
+            AddDocument(record.document_id, record.text,
+                        record.status, record.ratings);
+        } else {
+            RemoveDocument(record.document_id);
+        }
+        log_sequence_number_ = record.sequence_number;
+    }
+}
+
+uint64_t SearchServer::GetLogSequenceNumber() const {
+    return log_sequence_number_;
+}
+
+// RemoveDocument
+// The document is only marked removed: queries pass over its postings
+// and every posting list it is in counts one more removed posting, so
+// the IDF stays exact. Compact drops the postings later in bulk.
+void SearchServer::RemoveDocument(int document_id) {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
         return;
     }
 
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
+    const auto& term_freqs = GetDocumentTermFreqs(index);
+    for (const auto& [term, _] : term_freqs) {
+        term_postings_[term].MarkRemoved();
+    }
+    removed_posting_count_ += term_freqs.size();
+    documents_[index].is_removed = true;
+    generation_ = NextGeneration();
 
-    for_each(policy, word_freqs.begin(), word_freqs.end(),
-             [this, document_id](auto& wf) {
-                 word_to_document_freqs_[wf.first].erase(document_id);
-                 if (word_to_document_freqs_[wf.first].empty()) {
-                     word_to_document_freqs_.erase(wf.first);
-                 }
-             });
+    ReleaseDocument(index);
+    LogRemoveDocument(document_id);
 
-    document_ids_.erase(it);
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
+    if (removed_posting_count_
+        > posting_count_ * MAX_REMOVED_POSTING_SHARE) {
+        Compact();
+    }
 }
 
-// RemoveDocument parallel_policy
+// Marking is a counter update per word, there is nothing left to share
+// out between threads.
 void SearchServer::RemoveDocument(
-                   const std::execution::parallel_policy& policy,
+                   const std::execution::sequenced_policy&,
                    int document_id) {
-    std::set<int>::iterator
-    it = find(policy, document_ids_.begin(), document_ids_.end(),
-              document_id);
-    if (it == document_ids_.end()) {
-        return;
-    }
+    RemoveDocument(document_id);
+}
 
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
+void SearchServer::RemoveDocument(
+                   const std::execution::parallel_policy&,
+                   int document_id) {
+    RemoveDocument(document_id);
+}
 
-    std::vector<const std::string_view*>
-    words(word_freqs.size(), nullptr);
-    std::transform(/*policy,*/ word_freqs.begin(), word_freqs.end(),
-                   words.begin(),
-                   [](auto& wf) {
-                       return &wf.first;
-                   });
+// Compact
+// Every list owns its postings, so the lists with removed postings are
+// rebuilt concurrently. The words stay interned, a list left empty
+// takes no memory.
+void SearchServer::Compact() {
+    std::vector<PostingList*> compacted;
+    for (PostingList& postings : term_postings_) {
+        if (postings.LiveSize() != postings.Size()) {
+            compacted.push_back(&postings);
+        }
+    }
 
-    for_each(policy, words.begin(), words.end(),
-             [this, document_id](auto& ptr) {
-                 word_to_document_freqs_[*ptr].erase(document_id);
-//                 if (word_to_document_freqs_[*ptr].empty()) {
-//                     word_to_document_freqs_.erase(*ptr);
-//                 }
+    for_each(std::execution::par,
+             compacted.begin(), compacted.end(),
+             [this](PostingList* postings) {
+                 postings->EraseIf([this](int index) {
+                     return documents_[index].is_removed;
+                 });
              });
+    posting_count_ -= removed_posting_count_;
+    removed_posting_count_ = 0;
+}
+
+// Query cache
+void SearchServer::SetQueryCache(size_t capacity) {
+    if (capacity == 0) {
+        query_cache_.reset();
+    } else {
+        query_cache_ = std::make_shared<QueryCache>(capacity);
+    }
+}
 
-    document_ids_.erase(it);
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
+QueryCacheStatistics SearchServer::GetQueryCacheStatistics() const {
+    return query_cache_ ? query_cache_->GetStatistics()
+                        : QueryCacheStatistics{};
 }
 
 // FindTopDocuments
 std::vector<Document>
 SearchServer::FindTopDocuments(
               const std::string_view raw_query,
-              DocumentStatus status) const {
-    return FindTopDocuments(raw_query,
-           [status](int document_id,
-                    DocumentStatus document_status,
-                    int rating) {
-                        return document_status == status;
-                    });
+              DocumentStatus status,
+              size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status,
+                            top_count);
 }
 
 std::vector<Document>
@@ -173,31 +808,74 @@ SearchServer::FindTopDocuments(
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+// FindTopDocumentsWithAllWords
+std::vector<Document>
+SearchServer::FindTopDocumentsWithAllWords(
+              const std::string_view raw_query,
+              DocumentStatus status,
+              size_t top_count) const {
+    return FindTopDocumentsWithAllWords(raw_query,
+           [status](int,
+                    DocumentStatus document_status,
+                    int) {
+                        return document_status == status;
+                    },
+           top_count);
+}
+
+std::vector<Document>
+SearchServer::FindTopDocumentsWithAllWords(
+              const std::string_view raw_query) const {
+    return FindTopDocumentsWithAllWords(raw_query, DocumentStatus::ACTUAL);
+}
+
+CorpusStatistics
+SearchServer::GetCorpusStatistics(const std::string_view raw_query) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    CorpusStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    for (const uint32_t term : query.plus_terms) {
+        if (const PostingList* postings = FindPostings(term)) {
+            statistics.document_freqs[terms_.GetTerm(term)] =
+                postings->LiveSize();
+        }
+    }
+    return statistics;
+}
+
 // MatchDocument
 std::tuple<std::vector<std::string_view>, DocumentStatus>
 SearchServer::MatchDocument(const std::string_view raw_query,
                             int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
         throw std::invalid_argument("document_id out of range"s);
     }
 
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
-    const auto& query = ParseQuery(std::execution::seq, raw_query);
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    const auto contains = [this, index](uint32_t term) {
+        const PostingList* postings = FindPostings(term);
+        return postings != nullptr && postings->Contains(index);
+    };
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_freqs.count(word) > 0) {
-            return { {}, documents_.at(document_id).status };
+    for (const uint32_t term : query.minus_terms) {
+        if (contains(term)) {
+            return { std::vector<std::string_view>{},
+                     documents_[index].status };
         }
     }
 
     std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_freqs.count(word) > 0) {
-            matched_words.push_back(word);
+    for (const uint32_t term : query.plus_terms) {
+        if (contains(term)) {
+            matched_words.push_back(terms_.GetTerm(term));
         }
     }
+    std::sort(matched_words.begin(), matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { std::move(matched_words), documents_[index].status };
 }
 
 // MatchDocument sequenced_policy
@@ -206,48 +884,44 @@ SearchServer::MatchDocument(
               const std::execution::sequenced_policy& policy,
               const std::string_view raw_query,
               int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
         throw std::invalid_argument("document_id out of range"s);
     }
 
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
-    const auto& query = ParseQuery(policy, raw_query);
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    const auto contains = [this, index](uint32_t term) {
+        const PostingList* postings = FindPostings(term);
+        return postings != nullptr && postings->Contains(index);
+    };
 
     if (std::any_of(policy,
-                    query.minus_words.begin(),
-                    query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
-                    })) {
-        return { {}, documents_.at(document_id).status };
+                    query.minus_terms.begin(),
+                    query.minus_terms.end(),
+                    contains)) {
+        return { std::vector<std::string_view>{},
+                 documents_[index].status };
     }
 
-    std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
+    std::pmr::vector<uint32_t> matched_terms(arena.Resource());
+    matched_terms.reserve(query.plus_terms.size());
     std::copy_if(policy,
-                 query.plus_words.begin(),
-                 query.plus_words.end(),
-                 std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
-                 });
-
-/*
-    for (const std::string_view word : query.minus_words) {
-        if (word_freqs.count(word) > 0) {
-            return { {}, documents_.at(document_id).status };
-        }
-    }
-
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_freqs.count(word) > 0) {
-            matched_words.push_back(word);
-        }
-    }
-*/
+                 query.plus_terms.begin(),
+                 query.plus_terms.end(),
+                 std::back_inserter(matched_terms),
+                 contains);
+    std::vector<std::string_view> matched_words(matched_terms.size());
+    std::transform(matched_terms.begin(), matched_terms.end(),
+                   matched_words.begin(),
+                   [this](uint32_t term) {
+                       return terms_.GetTerm(term);
+                   });
+    std::sort(policy,
+              matched_words.begin(),
+              matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { std::move(matched_words), documents_[index].status };
 }
 
 // MatchDocument parallel_policy
@@ -256,31 +930,39 @@ SearchServer::MatchDocument(
               const std::execution::parallel_policy& policy,
               const std::string_view raw_query,
               int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
         throw std::invalid_argument("document_id out of range"s);
     }
 
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
-    const auto& query = ParseQuery(policy, raw_query, false);
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource(), false);
+    const auto contains = [this, index](uint32_t term) {
+        const PostingList* postings = FindPostings(term);
+        return postings != nullptr && postings->Contains(index);
+    };
 
     if (std::any_of(//policy,
-                    query.minus_words.begin(),
-                    query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
-                    })) {
-        return { {}, documents_.at(document_id).status };
+                    query.minus_terms.begin(),
+                    query.minus_terms.end(),
+                    contains)) {
+        return { std::vector<std::string_view>{},
+                 documents_[index].status };
     }
 
-    std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
+    std::pmr::vector<uint32_t> matched_terms(arena.Resource());
+    matched_terms.reserve(query.plus_terms.size());
     std::copy_if(//policy,
-                 query.plus_words.begin(),
-                 query.plus_words.end(),
-                 std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
-                 });
+                 query.plus_terms.begin(),
+                 query.plus_terms.end(),
+                 std::back_inserter(matched_terms),
+                 contains);
+    std::vector<std::string_view> matched_words(matched_terms.size());
+    std::transform(matched_terms.begin(), matched_terms.end(),
+                   matched_words.begin(),
+                   [this](uint32_t term) {
+                       return terms_.GetTerm(term);
+                   });
 
     std::sort(policy,
               matched_words.begin(),
@@ -290,7 +972,155 @@ SearchServer::MatchDocument(
                           matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { std::move(matched_words), documents_[index].status };
+}
+
+// Prepared queries
+// The words are kept as text, so the query can be looked up again in
+// any server; stop words are dropped here once.
+SearchServer::PreparedQuery
+SearchServer::PrepareQuery(const std::string_view raw_query) const {
+    PreparedQuery prepared;
+    ForEachWord(raw_query, [this, &prepared](std::string_view word,
+                                             bool is_valid) {
+        const auto query_word = ParseQueryWord(word, is_valid);
+        if (IsStopWord(query_word.data)) {
+            return;
+        }
+        (query_word.is_minus ? prepared.minus_words_
+                             : prepared.plus_words_)
+            .emplace_back(query_word.data);
+    });
+    for (auto* words : { &prepared.plus_words_, &prepared.minus_words_ }) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()),
+                     words->end());
+    }
+
+    prepared.server_ = this;
+    prepared.generation_ = generation_;
+    prepared.query_ = LookUpQueryWords(prepared,
+                                       std::pmr::get_default_resource());
+    prepared.terms_ = ResolveQueryTerms(prepared.query_,
+                                        std::pmr::get_default_resource());
+    return prepared;
+}
+
+std::vector<Document>
+SearchServer::FindTopDocuments(
+              const PreparedQuery& query,
+              DocumentStatus status,
+              size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, query, status,
+                            top_count);
+}
+
+std::vector<Document>
+SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+    return FindTopDocuments(query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+SearchServer::MatchDocument(const PreparedQuery& query,
+                            int document_id) const {
+    const int index = FindDocumentIndex(document_id);
+    if (index < 0) {
+        throw std::invalid_argument("document_id out of range"s);
+    }
+
+    QueryArena arena;
+    return WithPreparedQuery(query, arena.Resource(),
+        [this, index](const Query&, const QueryTerms& terms) {
+            return std::tuple(MatchQueryTerms(terms, index),
+                              documents_[index].status);
+        });
+}
+
+// MatchDocuments
+// The distinct indexes are sorted and cut into ranges, one task per
+// range. A task narrows its indexes by every word with Intersect and
+// Subtract, which decode only the blocks the indexes fall into, instead
+// of looking each document up in each list. Plus-words are taken in
+// word order, so the words of every document come out sorted.
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+SearchServer::MatchDocumentIndexes(const PreparedQuery& query,
+                                   const std::vector<int>& indexes) const {
+    std::vector<uint32_t> sorted_indexes(indexes.begin(), indexes.end());
+    std::sort(sorted_indexes.begin(), sorted_indexes.end());
+    sorted_indexes.erase(std::unique(sorted_indexes.begin(),
+                                     sorted_indexes.end()),
+                         sorted_indexes.end());
+    std::vector<std::vector<std::string_view>>
+    matched_words(sorted_indexes.size());
+
+    QueryArena arena;
+    WithPreparedQuery(query, arena.Resource(),
+        [this, &sorted_indexes, &matched_words, &arena]
+        (const Query&, const QueryTerms& terms) {
+            std::pmr::vector<const PlusTerm*> by_word(arena.Resource());
+            by_word.reserve(terms.plus.size());
+            for (const PlusTerm& plus : terms.plus) {
+                by_word.push_back(&plus);
+            }
+            std::sort(by_word.begin(), by_word.end(),
+                      [this](const PlusTerm* lhs, const PlusTerm* rhs) {
+                          return terms_.GetTerm(lhs->term)
+                                 < terms_.GetTerm(rhs->term);
+                      });
+
+            const int index_count = sorted_indexes.size();
+            const int range_count = std::clamp<int>(
+                index_count / MIN_PARALLEL_RANGE_DOCUMENTS, 1,
+                4 * std::max(1u, std::thread::hardware_concurrency()));
+            std::vector<int> ranges(range_count);
+            std::iota(ranges.begin(), ranges.end(), 0);
+            for_each (std::execution::par,
+                      ranges.begin(), ranges.end(),
+                      [this, &terms, &by_word, &sorted_indexes,
+                       &matched_words, index_count,
+                       range_count](int range) {
+                          const int first = int64_t{index_count} * range
+                                            / range_count;
+                          const int last = int64_t{index_count}
+                                           * (range + 1) / range_count;
+                          QueryArena arena;
+                          std::pmr::vector<uint32_t> candidates(
+                              sorted_indexes.begin() + first,
+                              sorted_indexes.begin() + last,
+                              arena.Resource());
+                          for (const PostingList* postings : terms.minus) {
+                              postings->Subtract(candidates);
+                          }
+                          std::pmr::vector<uint32_t> found(arena.Resource());
+                          for (const PlusTerm* plus : by_word) {
+                              found.assign(candidates.begin(),
+                                           candidates.end());
+                              plus->postings->Intersect(found);
+                              const std::string_view word =
+                                  terms_.GetTerm(plus->term);
+                              int position = first;
+                              for (const uint32_t index : found) {
+                                  while (sorted_indexes[position] != index) {
+                                      ++position;
+                                  }
+                                  matched_words[position].push_back(word);
+                              }
+                          }
+                      });
+        });
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+    result;
+    result.reserve(indexes.size());
+    for (const int index : indexes) {
+        const size_t position = std::lower_bound(sorted_indexes.begin(),
+                                                 sorted_indexes.end(),
+                                                 index)
+                                - sorted_indexes.begin();
+        result.emplace_back(matched_words[position],
+                            documents_[index].status);
+    }
+    return result;
 }
 
 // PRIVATE
@@ -306,29 +1136,57 @@ bool SearchServer::IsValidWord(const std::string_view word) {
                         });
 }
 
-bool SearchServer::IsNonValidWord(const std::string_view word) {
-    return std::any_of(word.begin(), word.end(),
-                       [](char c) {
-                           return c >= '\0' && c < ' ';
-                       });
-}
-
 std::vector<std::string_view>
 SearchServer::SplitIntoWordsNoStop(
               const std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
+    ForEachWord(text, [this, &words](std::string_view word, bool is_valid) {
+        if (!is_valid) {
             throw std::invalid_argument("Word "s + std::string(word)
                                                  + " is invalid"s);
         }
         if (!IsStopWord(word) && word.size() > 0) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
 
+void SearchServer::InvertBatchSlice(
+                   const std::vector<DocumentInput>& documents,
+                   int first_index,
+                   std::vector<DocumentData>& batch_data,
+                   BatchSlice& slice) const {
+    std::vector<uint32_t> numbers;
+    for (int i = slice.first; i < slice.last; ++i) {
+        const DocumentInput& document = documents[i];
+        const auto words = SplitIntoWordsNoStop(document.text);
+        batch_data[i] = { document.id,
+                          ComputeAverageRating(document.ratings),
+                          document.status, 1.0 / words.size() };
+
+        // Sorted numbers, the equal ones are counted as runs.
+        numbers.clear();
+        for (const std::string_view word : words) {
+            numbers.push_back(slice.words.Intern(word));
+        }
+        slice.postings.resize(slice.words.Size());
+        std::sort(numbers.begin(), numbers.end());
+        slice.document_offsets.push_back(slice.document_words.size());
+        for (size_t begin = 0, end = 0; begin < numbers.size();
+             begin = end) {
+            while (end < numbers.size() && numbers[end] == numbers[begin]) {
+                ++end;
+            }
+            const uint32_t count = end - begin;
+            slice.postings[numbers[begin]].emplace_back(first_index + i,
+                                                        count);
+            slice.document_words.emplace_back(numbers[begin], count);
+        }
+    }
+    slice.document_offsets.push_back(slice.document_words.size());
+}
+
 int SearchServer::ComputeAverageRating(
                   const std::vector<int>& ratings) {
     if (ratings.empty()) {
@@ -338,14 +1196,285 @@ int SearchServer::ComputeAverageRating(
            static_cast<int>(ratings.size());
 }
 
+void SearchServer::ExtendLogCounts() {
+    while (log_counts_.size() <= documents_.size()) {
+        log_counts_.push_back(std::log(log_counts_.size()));
+    }
+}
+
+double SearchServer::ComputeTermFreq(
+                     uint32_t count,
+                     const DocumentData& document_data) {
+    return count * document_data.inv_word_count;
+}
+
 double SearchServer::ComputeWordInverseDocumentFreq(
-                     const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 /
-               word_to_document_freqs_.at(word).size());
+                     uint32_t term,
+                     const PostingList& postings,
+                     const CorpusStatistics* statistics) const {
+    if (statistics == nullptr) {
+        return log_counts_[GetDocumentCount()]
+               - log_counts_[postings.LiveSize()];
+    }
+    // The same difference of logarithms as the table gives, so a server
+    // ranks with statistics of its own collection exactly as without.
+    return std::log(statistics->document_count)
+           - std::log(statistics->document_freqs.at(terms_.GetTerm(term)));
+}
+
+int SearchServer::FindDocumentIndex(int document_id) const {
+    const auto it = document_indexes_.find(document_id);
+    return it == document_indexes_.end() ? -1 : it->second;
+}
+
+void SearchServer::ReleaseDocument(int index) {
+    const int document_id = documents_[index].id;
+    document_ids_.erase(document_id);
+    document_indexes_.erase(document_id);
+    RemoveFingerprint(index);
+    auto& term_freqs = document_to_term_freqs_[index];
+    term_freqs.clear();
+    term_freqs.shrink_to_fit();
+}
+
+std::vector<Document> SearchServer::ToExternalDocuments(
+                      const std::pmr::vector<Document>& documents) const {
+    std::vector<Document> result;
+    result.reserve(documents.size());
+    for (const Document& document : documents) {
+        result.push_back({ documents_[document.id].id, document.relevance,
+                           document.rating });
+    }
+    return result;
+}
+
+SearchServer::PreparedQuery::PreparedQuery()
+    : query_(std::pmr::get_default_resource())
+    , terms_(std::pmr::get_default_resource())
+{
+}
+
+uint64_t SearchServer::NextGeneration() {
+    static std::atomic<uint64_t> next_generation{0};
+    return next_generation.fetch_add(1) + 1;
+}
+
+// Raw bytes of status, top_count, the plus-term count and the term
+// ids. All unknown words are one NO_TERM, they change no result.
+std::string SearchServer::MakeQueryCacheKey(const Query& query,
+                                            DocumentStatus status,
+                                            size_t top_count) {
+    std::string key;
+    const auto append = [&key](auto value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(static_cast<int32_t>(status));
+    append(static_cast<uint64_t>(top_count));
+    append(static_cast<uint32_t>(query.plus_terms.size()));
+    for (const uint32_t term : query.plus_terms) {
+        append(term);
+    }
+    for (const uint32_t term : query.minus_terms) {
+        append(term);
+    }
+    return key;
+}
+
+SearchServer::QueryTerms
+SearchServer::ResolveQueryTerms(const Query& query,
+                                std::pmr::memory_resource* scratch,
+                                const CorpusStatistics* statistics) const {
+    QueryTerms terms(scratch);
+    terms.plus.reserve(query.plus_terms.size());
+    terms.minus.reserve(query.minus_terms.size());
+    for (const uint32_t term : query.plus_terms) {
+        if (const PostingList* postings = FindPostings(term)) {
+            terms.plus.push_back({ term, postings,
+                ComputeWordInverseDocumentFreq(term, *postings,
+                                               statistics) });
+        }
+    }
+    for (const uint32_t term : query.minus_terms) {
+        if (const PostingList* postings = FindPostings(term)) {
+            terms.minus.push_back(postings);
+        }
+    }
+    return terms;
+}
+
+// Unknown words are NO_TERM, like ParseQuery gives them.
+SearchServer::Query
+SearchServer::LookUpQueryWords(const PreparedQuery& prepared,
+                               std::pmr::memory_resource* scratch) const {
+    Query query(scratch);
+    const auto look_up = [this](const std::vector<std::string>& words,
+                                std::pmr::vector<uint32_t>& terms) {
+        terms.reserve(words.size());
+        for (const std::string& word : words) {
+            terms.push_back(terms_.Find(word));
+        }
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    };
+    look_up(prepared.plus_words_, query.plus_terms);
+    look_up(prepared.minus_words_, query.minus_terms);
+    return query;
+}
+
+std::vector<std::string_view>
+SearchServer::MatchQueryTerms(const QueryTerms& terms, int index) const {
+    for (const PostingList* postings : terms.minus) {
+        if (postings->Contains(index)) {
+            return {};
+        }
+    }
+    std::vector<std::string_view> matched_words;
+    for (const PlusTerm& plus : terms.plus) {
+        if (plus.postings->Contains(index)) {
+            matched_words.push_back(terms_.GetTerm(plus.term));
+        }
+    }
+    std::sort(matched_words.begin(), matched_words.end());
+    return matched_words;
+}
+
+const SearchServer::TermFreqs&
+SearchServer::GetDocumentTermFreqs(int index) const {
+    if (static_cast<size_t>(index) < is_term_freqs_mapped_.size()) {
+        MappedForwardIndex& forward_index = *mapped_forward_index_;
+        std::lock_guard guard(forward_index.mutex);
+        if (is_term_freqs_mapped_[index]) {
+            auto& term_freqs = document_to_term_freqs_[index];
+            term_freqs.reserve(forward_index.offsets[index + 1]
+                               - forward_index.offsets[index]);
+            for (uint64_t i = forward_index.offsets[index];
+                 i < forward_index.offsets[index + 1]; ++i) {
+                term_freqs.emplace_back(forward_index.terms[i],
+                                        forward_index.freqs[i]);
+            }
+            is_term_freqs_mapped_[index] = 0;
+        }
+    }
+    return document_to_term_freqs_[index];
+}
+
+size_t SearchServer::GetDocumentTermCount(int index) const {
+    if (static_cast<size_t>(index) < is_term_freqs_mapped_.size()) {
+        MappedForwardIndex& forward_index = *mapped_forward_index_;
+        std::lock_guard guard(forward_index.mutex);
+        if (is_term_freqs_mapped_[index]) {
+            return forward_index.offsets[index + 1]
+                   - forward_index.offsets[index];
+        }
+    }
+    return document_to_term_freqs_[index].size();
+}
+
+void SearchServer::ComputeMinHash(int index, const TermFreqs& term_freqs) {
+    MinHasher min_hasher;
+    for (const auto& [term, _] : term_freqs) {
+        min_hasher.Add(term);
+    }
+    min_hasher.Finish(min_hashes_.data() + index * MIN_HASH_SIZE);
+}
+
+void SearchServer::ExtendTermFingerprints() {
+    for (uint32_t term = term_fingerprints_.size(); term < terms_.Size();
+         ++term) {
+        term_fingerprints_.push_back(HashWord(terms_.GetTerm(term)));
+    }
+}
+
+Fingerprint
+SearchServer::ComputeFingerprint(const TermFreqs& term_freqs) const {
+    Fingerprint fingerprint;
+    for (const auto& [term, _] : term_freqs) {
+        fingerprint += term_fingerprints_[term];
+    }
+    return fingerprint;
+}
+
+// The smallest id of a set stays first, one added below it pushes the
+// first one among the duplicates.
+void SearchServer::AddFingerprint(int index) {
+    if (GetDocumentTermCount(index) == 0) {
+        return;
+    }
+    const int document_id = documents_[index].id;
+    const Fingerprint& fingerprint = document_fingerprints_[index];
+    const auto [it, is_new] = fingerprint_to_first_id_.emplace(fingerprint,
+                                                               document_id);
+    if (is_new) {
+        return;
+    }
+    int duplicate_id = document_id;
+    if (document_id < it->second) {
+        std::swap(duplicate_id, it->second);
+    }
+    fingerprint_to_duplicate_ids_[fingerprint].insert(duplicate_id);
+    duplicate_ids_.insert(duplicate_id);
+}
+
+// Removing the first id of a set promotes its smallest duplicate.
+void SearchServer::RemoveFingerprint(int index) {
+    if (GetDocumentTermCount(index) == 0) {
+        return;
+    }
+    const int document_id = documents_[index].id;
+    const Fingerprint& fingerprint = document_fingerprints_[index];
+    const auto first = fingerprint_to_first_id_.find(fingerprint);
+    const auto duplicates = fingerprint_to_duplicate_ids_.find(fingerprint);
+    if (duplicates == fingerprint_to_duplicate_ids_.end()) {
+        fingerprint_to_first_id_.erase(first);
+        return;
+    }
+    std::pmr::set<int>& ids = duplicates->second;
+    int duplicate_id = document_id;
+    if (first->second == document_id) {
+        duplicate_id = *ids.begin();
+        first->second = duplicate_id;
+    }
+    ids.erase(duplicate_id);
+    duplicate_ids_.erase(duplicate_id);
+    if (ids.empty()) {
+        fingerprint_to_duplicate_ids_.erase(duplicates);
+    }
+}
+
+void SearchServer::LogAddDocument(int document_id,
+                                  const std::string_view document,
+                                  DocumentStatus status,
+                                  const std::vector<int>& ratings) {
+    if (log_.log) {
+        CommitToLog(log_.log->AppendAddDocument(document_id, document,
+                                            status, ratings));
+    }
+}
+
+void SearchServer::LogRemoveDocument(int document_id) {
+    if (log_.log) {
+        CommitToLog(log_.log->AppendRemoveDocument(document_id));
+    }
+}
+
+// The change is already applied when its record is appended; a failed
+// sync leaves it in memory and throws.
+void SearchServer::CommitToLog(uint64_t sequence_number) {
+    log_sequence_number_ = sequence_number;
+    if (log_.durability == LogDurability::SYNC) {
+        log_.log->WaitDurable(sequence_number);
+    }
+}
+
+const PostingList* SearchServer::FindPostings(uint32_t term) const {
+    return term >= term_postings_.size()
+           || term_postings_[term].LiveSize() == 0
+           ? nullptr : &term_postings_[term];
 }
 
 SearchServer::QueryWord
-SearchServer::ParseQueryWord(const std::string_view text) const {
+SearchServer::ParseQueryWord(const std::string_view text,
+                             bool is_valid) const {
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
@@ -356,10 +1485,54 @@ SearchServer::ParseQueryWord(const std::string_view text) const {
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || IsNonValidWord(word)) {
+    if (word.empty() || word[0] == '-' || !is_valid) {
         throw std::invalid_argument("Query word "s
                                     + std::string(text)
                                     + " is invalid"s);
     }
-    return { word, is_minus, IsStopWord(word) };
+    return { word, is_minus };
+}
+
+// ParseQuery
+SearchServer::Query
+SearchServer::ParseQuery(const std::string_view text,
+                         std::pmr::memory_resource* scratch,
+                         const bool make_unique) const {
+    Query result(scratch);
+    result.plus_terms.reserve(MAX_INSERTED_QUERY_TERMS);
+    result.minus_terms.reserve(MAX_INSERTED_QUERY_TERMS);
+    const auto add = [make_unique](std::pmr::vector<uint32_t>& terms,
+                                   uint32_t term) {
+        if (!make_unique || terms.size() >= MAX_INSERTED_QUERY_TERMS) {
+            terms.push_back(term);
+            return;
+        }
+        const auto it = std::lower_bound(terms.begin(), terms.end(), term);
+        if (it == terms.end() || *it != term) {
+            terms.insert(it, term);
+        }
+    };
+    ForEachWord(text, [this, &result, &add](std::string_view word,
+                                            bool is_valid) {
+        const auto query_word = ParseQueryWord(word, is_valid);
+        // A known word is never a stop word.
+        const uint32_t term = terms_.Find(query_word.data);
+        if (term == TermInterner::NO_TERM
+            && IsStopWord(query_word.data)) {
+            return;
+        }
+        add(query_word.is_minus ? result.minus_terms : result.plus_terms,
+            term);
+    });
+
+    if (make_unique) {
+        for (auto* terms : { &result.plus_terms, &result.minus_terms }) {
+            if (terms->size() > MAX_INSERTED_QUERY_TERMS) {
+                std::sort(terms->begin(), terms->end());
+                terms->erase(std::unique(terms->begin(), terms->end()),
+                             terms->end());
+            }
+        }
+    }
+    return result;
 }
\ No newline at end of file
@@ -1,44 +1,150 @@
 #pragma once
 
-#include "concurrent_map.h"
+#include "arena.h"
+#include "corpus_statistics.h"
 #include "document.h"
+#include "fingerprint.h"
+#include "index_bitmap.h"
+#include "min_hash.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "score_accumulator.h"
+#include "snapshot.h"
 #include "string_processing.h"
+#include "term_interner.h"
+#include "word_frequencies.h"
+#include "write_ahead_log.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <exception>
 #include <execution>
+#include <limits>
 #include <list>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const int CONCURRENT_MAP_BUCKETS = 101;
-const double MIN_REAL_VALUE = 1e-6;
+const size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t MIN_PARALLEL_RANGE_POSTINGS = 4096;
+const size_t MIN_PARALLEL_RANGE_DOCUMENTS = 256;
+const size_t MAX_INSERTED_QUERY_TERMS = 32;
+const size_t MAX_LSH_BUCKET_NEIGHBORS = 8;
+const double MAX_REMOVED_POSTING_SHARE = 0.25;
 
 class SearchServer {
 public:
+// The per-document containers of the index are pooled over upstream,
+// see IndexArena; queries work in a QueryArena of their thread.
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words,
+                          std::pmr::memory_resource* upstream
+                              = std::pmr::get_default_resource());
 
     void AddDocument(int document_id,
                      const std::string_view document,
                      DocumentStatus status,
                      const std::vector<int>& ratings);
 
+// Adds the batch in parallel. The index is the same as after adding
+// the documents one by one in batch order, but nothing is added when
+// any of them is invalid.
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+
     int GetDocumentCount() const;
 
-    std::set<int>::const_iterator begin() const;
+    std::pmr::set<int>::const_iterator begin() const;
 
-    std::set<int>::const_iterator end() const;
+    std::pmr::set<int>::const_iterator end() const;
 
+// Duplicates
+// Ids of the documents whose word set equals that of a document with a
+// smaller id, in increasing order. Documents are grouped by the
+// fingerprints of their word sets, see fingerprint.h, as they are added
+// and removed, so this only copies the ids out. Documents without words,
+// e.g. of stop words only, are never duplicates.
     std::list<int> GetDuplicates() const;
 
-    const std::map<std::string_view, double>&
-    GetWordFrequencies(int document_id) const;
+// Whether a document with a smaller id has the same word set.
+    bool IsDuplicate(int document_id) const;
+
+// Id of the first document with the word set of document, i.e. the one
+// AddDocument would make it a duplicate of. Lets callers reject a
+// duplicate before adding it. Throws on an invalid document like
+// AddDocument does.
+    std::optional<int> FindDuplicate(const std::string_view document) const;
+
+// Near-duplicates
+// Groups of documents whose word sets are linked by pairs with a
+// Jaccard similarity of at least threshold, which has to be in (0, 1].
+// Ids are increasing within a group, groups are ordered by their first
+// id. Candidate pairs come from the LSH bands of MinHash signatures
+// taken when documents are added, see min_hash.h, and are checked
+// exactly; a pair of similarity threshold is found with probability
+// MIN_LSH_RECALL or more, equal word sets always. Documents without
+// words have no defined similarity and are in no group.
+    std::vector<std::vector<int>> GetNearDuplicates(double threshold) const;
+
+// Word frequencies of the document, empty for a missing one. The view
+// reads the index in place, see WordFrequencies for how long it lives.
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+// Snapshot
+// Writes the whole state of the server to path, see snapshot.h. The
+// old file is only replaced by a complete new one, so a server may save
+// over the snapshot it was loaded from.
+    void SaveSnapshot(const std::string& path) const;
+
+// Opens a snapshot written by SaveSnapshot. The posting lists are read
+// in place from the mapped file, so only the dictionary and the document
+// table are rebuilt and pages of postings are read when queries first
+// touch them. The word frequencies of a document are built from the
+// mapping on first use, a posting list is copied into memory the first
+// time it changes. MinHash signatures are computed while loading.
+// Block headers and tails are always checked against the document
+// table; the block bytes only by FULL, see SnapshotVerification.
+// Throws std::runtime_error when the file cannot be read or fails the
+// checks.
+    static SearchServer LoadSnapshot(
+        const std::string& path,
+        SnapshotVerification verification
+            = SnapshotVerification::FULL);
+
+// Log
+// From now on every AddDocument, AddDocuments and RemoveDocument that
+// changes the server is appended to log, see write_ahead_log.h. With
+// LogDurability::SYNC the call returns once its records are on disk, a
+// whole AddDocuments batch shares one sync. The log has to end where the
+// state of the server does: it is the log the server was replayed from,
+// or an empty one for a server that has no records yet. Throws
+// std::invalid_argument otherwise. A copy of the server starts without
+// a log, its changes are not recorded in the log of the original.
+    void AttachLog(std::shared_ptr<WriteAheadLog> log,
+                   LogDurability durability = LogDurability::SYNC);
+
+// Applies the records of the log at path that are newer than the state
+// of the server, e.g. the ones appended after the snapshot it was
+// loaded from. Has to come before AttachLog.
+    void ReplayLog(const std::string& path);
+
+// Number of the last log record the state of the server includes.
+    uint64_t GetLogSequenceNumber() const;
 
 // RemoveDocument
+// Marks the document removed, it leaves every query at once. Its
+// postings stay in the index until Compact, which runs by itself when
+// removed postings exceed MAX_REMOVED_POSTING_SHARE of all postings.
     void RemoveDocument(int document_id);
 
     void RemoveDocument(const std::execution::sequenced_policy& policy,
@@ -47,15 +153,34 @@ public:
     void RemoveDocument(const std::execution::parallel_policy& policy,
                         int document_id);
 
+// Drops the postings of removed documents. Query results do not
+// change.
+    void Compact();
+
+// Query cache
+// Keeps the results of up to capacity FindTopDocuments calls that
+// select by status. They are keyed by the parsed query, so word order,
+// repeated words and stop words do not make new entries. Any change to
+// the documents invalidates all of them; queries with a predicate
+// always run. capacity 0 turns the cache off. Copies of the server
+// share the cache.
+    void SetQueryCache(size_t capacity);
+
+    QueryCacheStatistics GetQueryCacheStatistics() const;
+
 // FindTopDocuments
+// top_count limits the result size, at most top_count documents are
+// ranked, the rest of the matches are only selected out.
     template <typename Predicate>
     std::vector<Document>
     FindTopDocuments(const std::string_view raw_query,
-                     Predicate document_predicate) const;
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document>
     FindTopDocuments(const std::string_view raw_query,
-                     DocumentStatus status) const;
+                     DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document>
     FindTopDocuments(const std::string_view raw_query) const;
@@ -64,19 +189,54 @@ public:
     std::vector<Document>
     FindTopDocuments(const ExecutionPolicy& policy,
                      const std::string_view raw_query,
-                     Predicate document_predicate) const;
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document>
     FindTopDocuments(const ExecutionPolicy& policy,
                      const std::string_view raw_query,
-                     DocumentStatus status) const;
+                     DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document>
     FindTopDocuments(const ExecutionPolicy& policy,
                      const std::string_view raw_query) const;
 
+// FindTopDocumentsWithAllWords
+// Conjunctive queries: only the documents that contain every plus-word
+// match. Relevance is the same as FindTopDocuments gives them.
+    template <typename Predicate>
+    std::vector<Document>
+    FindTopDocumentsWithAllWords(
+        const std::string_view raw_query,
+        Predicate document_predicate,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocumentsWithAllWords(
+        const std::string_view raw_query,
+        DocumentStatus status,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocumentsWithAllWords(const std::string_view raw_query) const;
+
+// Ranks with the IDF of a larger collection this server is a part of,
+// see ShardedSearchServer.
+    template <typename Predicate>
+    std::vector<Document>
+    FindTopDocuments(const CorpusStatistics& statistics,
+                     const std::string_view raw_query,
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+// Document count and the document frequencies of the query plus-words.
+// Throws on an invalid query like FindTopDocuments does.
+    CorpusStatistics
+    GetCorpusStatistics(const std::string_view raw_query) const;
+
 // MatchDocument
     std::tuple<std::vector<std::string_view>, DocumentStatus>
     MatchDocument(const std::string_view raw_query, int document_id) const;
@@ -89,80 +249,447 @@ public:
     MatchDocument(const std::execution::parallel_policy& policy,
                   const std::string_view raw_query, int document_id) const;
 
+// Prepared queries
+// Parses raw_query and looks its words up once, see PreparedQuery.
+// Throws on an invalid query like FindTopDocuments does.
+    class PreparedQuery;
+
+    PreparedQuery PrepareQuery(const std::string_view raw_query) const;
+
+    template <typename Predicate>
+    std::vector<Document>
+    FindTopDocuments(const PreparedQuery& query,
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(const PreparedQuery& query,
+                     DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(const PreparedQuery& query) const;
+
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document>
+    FindTopDocuments(const ExecutionPolicy& policy,
+                     const PreparedQuery& query,
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocuments(const ExecutionPolicy& policy,
+                     const PreparedQuery& query,
+                     DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocuments(const ExecutionPolicy& policy,
+                     const PreparedQuery& query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(const PreparedQuery& query, int document_id) const;
+
+// Matches query against the documents of document_ids, any range of
+// ids, in one parallel sweep over the postings. Result i is what
+// MatchDocument gives for the i-th id. Throws std::invalid_argument
+// before matching anything when an id is not in the server.
+    template <typename DocumentIds>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+    MatchDocuments(const PreparedQuery& query,
+                   const DocumentIds& document_ids) const;
+
 private:
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        double inv_word_count;
+        bool is_removed = false;
     };
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
-        bool is_stop;
     };
 
+// Term ids of the query words. Words the vocabulary lacks are kept as
+// TermInterner::NO_TERM, they match no document.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_terms(resource)
+            , minus_terms(resource)
+        {
+        }
+
+        std::pmr::vector<uint32_t> plus_terms;
+        std::pmr::vector<uint32_t> minus_terms;
+    };
+
+// Term ids of a document with their term frequencies, by id.
+    using TermFreqs = std::pmr::vector<std::pair<uint32_t, double>>;
+
+// Part of an AddDocuments batch, [first, last) in batch positions,
+// inverted by one task. The slice interns its words in an interner of
+// its own, as AddDocument does in terms_, so the numbers follow the
+// order the slice meets them; merging gives every number its term id
+// in terms.
+    struct BatchSlice {
+        int first = 0;
+        int last = 0;
+        TermInterner words;
+        std::vector<uint32_t> terms;
+        std::vector<std::vector<std::pair<int, uint32_t>>> postings;
+        // (number, count) of the words of every document, those of
+        // document i from document_offsets[i - first] on.
+        std::vector<std::pair<uint32_t, uint32_t>> document_words;
+        std::vector<size_t> document_offsets;
+        std::exception_ptr error;
+    };
+
+// Postings of the query words found in the index, plus-words in query
+// order together with their term ids and IDF.
+    struct PlusTerm {
+        uint32_t term;
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+
+    struct QueryTerms {
+        explicit QueryTerms(std::pmr::memory_resource* resource)
+            : plus(resource)
+            , minus(resource)
+        {
+        }
+
+        std::pmr::vector<PlusTerm> plus;
+        std::pmr::vector<const PostingList*> minus;
     };
 
     const std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string, std::less<>> words_;
 
-    std::map<std::string_view, std::map<int, double>>
-    word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>>
-    document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+// Declared before the containers that allocate from it.
+    IndexArena index_arena_;
+
+// Words are interned once, the indexes and parsed queries only hold
+// their ids; term_postings_ is indexed by term id. Stop words are never
+// interned.
+    TermInterner terms_;
+    std::vector<PostingList> term_postings_;
+
+// Documents are numbered densely in the order they are added; these
+// internal indexes are what the postings and the per-document arrays
+// are keyed by. External ids only appear at the API boundary.
+    mutable std::pmr::vector<TermFreqs> document_to_term_freqs_;
+    std::vector<DocumentData> documents_;
+    std::pmr::unordered_map<int, int> document_indexes_;
+    std::pmr::set<int> document_ids_;
+
+// MIN_HASH_SIZE values per internal index, the signature of the term
+// set of the document.
+    std::vector<uint32_t> min_hashes_;
+
+// Fingerprints of the words by term id and of the documents by index.
+// Every word set of the live documents has its smallest id in
+// fingerprint_to_first_id_. The other ids are duplicates, they are in
+// duplicate_ids_ and, by fingerprint, in fingerprint_to_duplicate_ids_,
+// which only has the sets that have duplicates.
+    std::vector<Fingerprint> term_fingerprints_;
+    std::vector<Fingerprint> document_fingerprints_;
+    std::pmr::unordered_map<Fingerprint, int, FingerprintHash>
+    fingerprint_to_first_id_;
+    std::pmr::unordered_map<Fingerprint, std::pmr::set<int>, FingerprintHash>
+    fingerprint_to_duplicate_ids_;
+    std::pmr::set<int> duplicate_ids_;
+
+// All postings in the index and those of removed documents among them.
+    size_t posting_count_ = 0;
+    size_t removed_posting_count_ = 0;
+
+// log_counts_[n] is log(n) for every n up to the number of documents
+// ever added, so the IDF of a word is a difference of two entries and
+// queries compute no logarithms.
+    std::vector<double> log_counts_;
+
+// Mapped snapshot the server was loaded from, posting lists may still
+// read from it.
+    std::shared_ptr<const MappedFile> snapshot_file_;
+
+// Forward index of the snapshot documents. The term frequencies of
+// such a document are only copied from the mapped arrays when they are
+// first needed, see GetDocumentTermFreqs; is_term_freqs_mapped_ marks
+// the ones still to copy and is guarded by the mutex.
+    struct MappedForwardIndex {
+        SnapshotReader::Array<uint64_t> offsets;
+        SnapshotReader::Array<uint32_t> terms;
+        SnapshotReader::Array<double> freqs;
+        std::mutex mutex;
+    };
+
+    std::shared_ptr<MappedForwardIndex> mapped_forward_index_;
+    mutable std::vector<char> is_term_freqs_mapped_;
+
+// The log the changes are appended to. Copying leaves it behind, so a
+// copy of the server has none; moving takes it along.
+    struct AttachedLog {
+        std::shared_ptr<WriteAheadLog> log;
+        LogDurability durability = LogDurability::SYNC;
+
+        AttachedLog() = default;
+
+        AttachedLog(const AttachedLog&) {
+        }
+
+        AttachedLog& operator=(const AttachedLog&) {
+            *this = AttachedLog();
+            return *this;
+        }
+
+        AttachedLog(AttachedLog&&) = default;
+
+        AttachedLog& operator=(AttachedLog&&) = default;
+    };
+
+    AttachedLog log_;
+    uint64_t log_sequence_number_ = 0;
+
+// Taken anew from NextGeneration by every change to the documents.
+// Generations are unique over all servers, so copies that share a
+// query cache never hit each other's entries once they differ.
+    std::shared_ptr<QueryCache> query_cache_;
+    uint64_t generation_ = 0;
+
+    static uint64_t NextGeneration();
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    static bool IsNonValidWord(const std::string_view word);
-
     std::vector<std::string_view>
     SplitIntoWordsNoStop(const std::string_view text) const;
 
+    void InvertBatchSlice(const std::vector<DocumentInput>& documents,
+                          int first_index,
+                          std::vector<DocumentData>& batch_data,
+                          BatchSlice& slice) const;
+
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-// Existence required
+    void ExtendLogCounts();
+
+// Uses the own counts of the server when statistics is nullptr.
+    static double ComputeTermFreq(uint32_t count,
+                                  const DocumentData& document_data);
+
     double ComputeWordInverseDocumentFreq(
-           const std::string_view word) const;
+           uint32_t term,
+           const PostingList& postings,
+           const CorpusStatistics* statistics = nullptr) const;
 
-    QueryWord ParseQueryWord(const std::string_view text) const;
+// Null when the term has no postings of live documents.
+    const PostingList* FindPostings(uint32_t term) const;
+
+    const TermFreqs& GetDocumentTermFreqs(int index) const;
+
+// Number of distinct words of the document, also of a mapped one
+// without copying its word frequencies.
+    size_t GetDocumentTermCount(int index) const;
+
+// min_hashes_ has to hold the index already.
+    void ComputeMinHash(int index, const TermFreqs& term_freqs);
+
+// Hashes the words interned since the last call.
+    void ExtendTermFingerprints();
+
+    Fingerprint ComputeFingerprint(const TermFreqs& term_freqs) const;
+
+// Register and unregister the fingerprint of the document with internal
+// index index. A document without words is left out: its empty word set
+// is no evidence of a copy, and all of them would share one fingerprint.
+    void AddFingerprint(int index);
+
+    void RemoveFingerprint(int index);
+
+    void LogAddDocument(int document_id,
+                        const std::string_view document,
+                        DocumentStatus status,
+                        const std::vector<int>& ratings);
+
+    void LogRemoveDocument(int document_id);
+
+    void CommitToLog(uint64_t sequence_number);
+
+    int FindDocumentIndex(int document_id) const;
+
+    void ReleaseDocument(int index);
+
+// The result of a query: documents with internal indexes as ids,
+// copied out of the query arena with external ids.
+    std::vector<Document>
+    ToExternalDocuments(const std::pmr::vector<Document>& documents) const;
+
+    static std::string MakeQueryCacheKey(const Query& query,
+                                         DocumentStatus status,
+                                         size_t top_count);
+
+// is_valid tells whether text is free of control characters, the
+// tokenizer checks that while it splits.
+    QueryWord ParseQueryWord(const std::string_view text,
+                             bool is_valid) const;
 
-// ParseQuery
     template <typename ExecutionPolicy>
-    Query ParseQuery(const ExecutionPolicy& policy,
-                     const std::string_view text,
+    static void SelectTopDocuments(const ExecutionPolicy& policy,
+                                   std::pmr::vector<Document>& documents,
+                                   size_t top_count);
+
+// ParseQuery
+// The query and everything found for it below is allocated from
+// scratch, the resource of the QueryArena of the calling query.
+// Tokenizing, dropping stop words and sorting out minus-words and
+// duplicates is one pass over the text; the term lists are reserved
+// for MAX_INSERTED_QUERY_TERMS up front and keep themselves sorted and
+// unique while they are not longer. Longer ones grow in scratch and are
+// sorted once at the end. Queries are short, so nothing runs in
+// parallel here whatever the policy of the caller.
+    Query ParseQuery(const std::string_view text,
+                     std::pmr::memory_resource* scratch,
                      const bool make_unique = true) const;
 
 // FindAllDocuments
+// Found documents carry internal indexes as ids.
     template <typename Predicate>
-    std::vector<Document>
-    FindAllDocuments(const Query& query,
-                     Predicate document_predicate) const;
+    std::pmr::vector<Document>
+    FindAllDocuments(const QueryTerms& terms,
+                     Predicate document_predicate,
+                     std::pmr::memory_resource* scratch) const;
 
     template <typename Predicate>
-    std::vector<Document>
+    std::pmr::vector<Document>
     FindAllDocuments(const std::execution::sequenced_policy& policy,
-                     const Query& query,
-                     Predicate document_predicate) const;
+                     const QueryTerms& terms,
+                     Predicate document_predicate,
+                     std::pmr::memory_resource* scratch) const;
 
     template <typename Predicate>
-    std::vector<Document>
+    std::pmr::vector<Document>
     FindAllDocuments(const std::execution::parallel_policy& policy,
-                     const Query& query,
-                     Predicate document_predicate) const;
+                     const QueryTerms& terms,
+                     Predicate document_predicate,
+                     std::pmr::memory_resource* scratch) const;
+
+// IDF comes from statistics when it is not nullptr.
+    QueryTerms ResolveQueryTerms(const Query& query,
+                                 std::pmr::memory_resource* scratch,
+                                 const CorpusStatistics* statistics
+                                     = nullptr) const;
+
+// Scores the documents with internal indexes in [first, last).
+    template <typename Predicate>
+    void FindDocumentsInRange(const QueryTerms& terms,
+                              Predicate& document_predicate,
+                              int first, int last,
+                              std::pmr::vector<Document>& matched_documents,
+                              std::pmr::memory_resource* scratch) const;
+
+// Intersects the plus-word postings rarest first, then subtracts the
+// minus-word ones.
+    template <typename Predicate>
+    std::pmr::vector<Document>
+    FindAllDocumentsWithAllWords(const Query& query,
+                                 Predicate document_predicate,
+                                 std::pmr::memory_resource* scratch) const;
+
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document>
+    FindTopDocumentsForQuery(const ExecutionPolicy& policy,
+                             const QueryTerms& terms,
+                             Predicate document_predicate,
+                             size_t top_count,
+                             std::pmr::memory_resource* scratch) const;
+
+// Goes to the query cache first when there is one. terms is resolved
+// from query only on a miss when it is nullptr.
+    template <typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocumentsWithStatus(const ExecutionPolicy& policy,
+                               const Query& query,
+                               const QueryTerms* terms,
+                               DocumentStatus status,
+                               size_t top_count,
+                               std::pmr::memory_resource* scratch) const;
+
+// FindTopDocumentsPruned
+// MaxScore retrieval: the same top_count documents as FindAllDocuments
+// followed by SelectTopDocuments, but only documents that can still
+// get into the current top are fully scored.
+    template <typename Predicate>
+    std::vector<Document>
+    FindTopDocumentsPruned(const QueryTerms& terms,
+                           Predicate document_predicate,
+                           size_t top_count,
+                           std::pmr::memory_resource* scratch) const;
+
+// Term ids of the words of a prepared query in this server.
+    Query LookUpQueryWords(const PreparedQuery& prepared,
+                           std::pmr::memory_resource* scratch) const;
+
+// Calls function(query, terms) with the query and the terms of prepared
+// for this server as it is now: those prepared holds when this server
+// prepared it and has not changed since, otherwise ones looked up anew
+// in scratch.
+    template <typename Function>
+    auto WithPreparedQuery(const PreparedQuery& prepared,
+                           std::pmr::memory_resource* scratch,
+                           Function function) const;
+
+// Plus-words of terms the document has, sorted, none when it has a
+// minus-word.
+    std::vector<std::string_view>
+    MatchQueryTerms(const QueryTerms& terms, int index) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+    MatchDocumentIndexes(const PreparedQuery& query,
+                         const std::vector<int>& indexes) const;
+};
+
+// A query parsed once and resolved against the index of the server
+// that prepared it: the term ids of its words, the postings they select
+// and their IDF. On that server it runs without parsing or lookups as
+// long as the server does not change. It stays valid after changes and
+// on other servers, e.g. copies or later snapshots of the collection:
+// there its words are looked up again on every run, the parsing is
+// still skipped. Results are always those of its text. Copies are
+// independent; a prepared query may be run from many threads at once.
+class SearchServer::PreparedQuery {
+private:
+    friend class SearchServer;
+
+    PreparedQuery();
+
+    const SearchServer* server_ = nullptr;
+    uint64_t generation_ = 0;
+    std::vector<std::string> plus_words_;
+    std::vector<std::string> minus_words_;
+    Query query_;
+    QueryTerms terms_;
 };
 
 // PUBLIC
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words,
+                           std::pmr::memory_resource* upstream)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , index_arena_(upstream)
+    , document_to_term_freqs_(index_arena_.Resource())
+    , document_indexes_(index_arena_.Resource())
+    , document_ids_(index_arena_.Resource())
+    , fingerprint_to_first_id_(index_arena_.Resource())
+    , fingerprint_to_duplicate_ids_(index_arena_.Resource())
+    , duplicate_ids_(index_arena_.Resource())
+    , generation_(NextGeneration())
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(),
                 IsValidWord)) {
@@ -176,27 +703,13 @@ template <typename Predicate>
 std::vector<Document>
 SearchServer::FindTopDocuments(
               const std::string_view raw_query,
-              Predicate document_predicate) const {
-    const auto query = ParseQuery(std::execution::seq, raw_query);
-    auto matched_documents = FindAllDocuments(query,
-                                              document_predicate);
-
-    std::sort(matched_documents.begin(),
-              matched_documents.end(),
-              [](const Document& lhs, const Document& rhs) {
-                  if (std::abs(lhs.relevance - rhs.relevance) <
-                      MIN_REAL_VALUE) {
-                      return lhs.rating > rhs.rating;
-                  } else {
-                      return lhs.relevance > rhs.relevance;
-                  }
-              });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+              Predicate document_predicate,
+              size_t top_count) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    return FindTopDocumentsPruned(ResolveQueryTerms(query, arena.Resource()),
+                                  document_predicate, top_count,
+                                  arena.Resource());
 }
 
 template <typename ExecutionPolicy, typename Predicate>
@@ -204,28 +717,15 @@ std::vector<Document>
 SearchServer::FindTopDocuments(
               const ExecutionPolicy& policy,          
               const std::string_view raw_query,
-              Predicate document_predicate) const {
-    const Query query = ParseQuery(policy, raw_query);
-    std::vector<Document>
-    matched_documents = FindAllDocuments(policy, query,
-                                         document_predicate);
- 
-    std::sort(policy, matched_documents.begin(),
-              matched_documents.end(),
-              [](const Document& lhs, const Document& rhs) {
-                  if (std::abs(lhs.relevance - rhs.relevance) <
-                      MIN_REAL_VALUE) {
-                      return lhs.rating > rhs.rating;
-                  } else {
-                      return lhs.relevance > rhs.relevance;
-                  }
-              });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+              Predicate document_predicate,
+              size_t top_count) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    return FindTopDocumentsForQuery(policy,
+                                    ResolveQueryTerms(query,
+                                                      arena.Resource()),
+                                    document_predicate, top_count,
+                                    arena.Resource());
 }
 
 template <typename ExecutionPolicy>
@@ -233,13 +733,12 @@ std::vector<Document>
 SearchServer::FindTopDocuments(
               const ExecutionPolicy& policy,
               const std::string_view raw_query,
-              DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
-           [status](int document_id,
-                    DocumentStatus document_status,
-                    int rating) {
-                        return document_status == status;
-                    });
+              DocumentStatus status,
+              size_t top_count) const {
+    QueryArena arena;
+    const Query query = ParseQuery(raw_query, arena.Resource());
+    return FindTopDocumentsWithStatus(policy, query, nullptr, status,
+                                      top_count, arena.Resource());
 }
 
 template <typename ExecutionPolicy>
@@ -251,167 +750,553 @@ SearchServer::FindTopDocuments(
                             DocumentStatus::ACTUAL);
 }
 
-// PRIVATE
-
-// ParseQuery
-template <typename ExecutionPolicy>
-SearchServer::Query
-SearchServer::ParseQuery(const ExecutionPolicy& policy,
-                         const std::string_view text,
-                         const bool make_unique) const {
-    Query result;
-    bool has_minus = false;
-    bool has_plus = false;
-    const auto& words = SplitIntoWords(text);
-    for_each(/*policy,*/ words.begin(), words.end(),
-             [this, &has_minus, &has_plus, &result]
-             (std::string_view word) {
-                 const auto query_word = ParseQueryWord(word);
-                 if (!query_word.is_stop) {
-                     if (query_word.is_minus) {
-                         has_minus = true;
-                         result.minus_words.push_back(query_word.data);
-                     } else {
-                         has_plus = true;
-                         result.plus_words.push_back(query_word.data);
-                     }
-                 }
-             });
-
-    if (!make_unique) {
-        return result;
-    }
+// FindTopDocumentsWithAllWords
+template <typename Predicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsWithAllWords(
+              const std::string_view raw_query,
+              Predicate document_predicate,
+              size_t top_count) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    auto matched_documents = FindAllDocumentsWithAllWords(
+                             query, document_predicate, arena.Resource());
+    SelectTopDocuments(std::execution::seq, matched_documents, top_count);
+    return ToExternalDocuments(matched_documents);
+}
 
-    if (has_minus) {
-        std::sort(policy, result.minus_words.begin(),
-                  result.minus_words.end());
-        auto it = std::unique(policy, result.minus_words.begin(),
-                              result.minus_words.end());
-        result.minus_words.erase(it, result.minus_words.end());
-    }
-    if (has_plus) {
-        std::sort(policy, result.plus_words.begin(),
-                  result.plus_words.end());
-        auto it = std::unique(policy, result.plus_words.begin(),
-                              result.plus_words.end());
-        result.plus_words.erase(it, result.plus_words.end());
-    }
-    return result;
+template <typename Predicate>
+std::vector<Document>
+SearchServer::FindTopDocuments(
+              const CorpusStatistics& statistics,
+              const std::string_view raw_query,
+              Predicate document_predicate,
+              size_t top_count) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.Resource());
+    return FindTopDocumentsPruned(ResolveQueryTerms(query, arena.Resource(),
+                                                    &statistics),
+                                  document_predicate, top_count,
+                                  arena.Resource());
 }
 
-// FindAllDocuments
+// Prepared queries
 template <typename Predicate>
 std::vector<Document>
-SearchServer::FindAllDocuments(const Query& query,
-                               Predicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+SearchServer::FindTopDocuments(
+              const PreparedQuery& query,
+              Predicate document_predicate,
+              size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, query,
+                            document_predicate, top_count);
+}
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document>
+SearchServer::FindTopDocuments(
+              const ExecutionPolicy& policy,
+              const PreparedQuery& query,
+              Predicate document_predicate,
+              size_t top_count) const {
+    QueryArena arena;
+    return WithPreparedQuery(query, arena.Resource(),
+        [this, &policy, &document_predicate, top_count, &arena]
+        (const Query&, const QueryTerms& terms) {
+            return FindTopDocumentsForQuery(policy, terms,
+                                            document_predicate, top_count,
+                                            arena.Resource());
+        });
+}
 
-        const double inverse_document_freq =
-                     ComputeWordInverseDocumentFreq(word);
-
-        for (const auto [document_id, term_freq] :
-             word_to_document_freqs_.at(word)) {
-            const auto& document_data =
-                documents_.at(document_id);
-            if (document_predicate(document_id,
-                document_data.status,
-                document_data.rating)) {
-                document_to_relevance[document_id] +=
-                    term_freq * inverse_document_freq;
-            }
-        }
-    }
+template <typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(
+              const ExecutionPolicy& policy,
+              const PreparedQuery& query,
+              DocumentStatus status,
+              size_t top_count) const {
+    QueryArena arena;
+    return WithPreparedQuery(query, arena.Resource(),
+        [this, &policy, status, top_count, &arena]
+        (const Query& parsed, const QueryTerms& terms) {
+            return FindTopDocumentsWithStatus(policy, parsed, &terms,
+                                              status, top_count,
+                                              arena.Resource());
+        });
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+template <typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(
+              const ExecutionPolicy& policy,
+              const PreparedQuery& query) const {
+    return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
 
-        for (const auto [document_id, _] :
-            word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+template <typename DocumentIds>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>>
+SearchServer::MatchDocuments(const PreparedQuery& query,
+                             const DocumentIds& document_ids) const {
+    std::vector<int> indexes;
+    for (const int document_id : document_ids) {
+        const int index = FindDocumentIndex(document_id);
+        if (index < 0) {
+            throw std::invalid_argument("document_id out of range"s);
         }
+        indexes.push_back(index);
     }
+    return MatchDocumentIndexes(query, indexes);
+}
+
+// PRIVATE
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] :
-         document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance,
-              documents_.at(document_id).rating });
+// Leaves the top_count best documents in ranking order. Only these are
+// ordered, partial_sort keeps a top_count sized heap while scanning the
+// rest of the matches.
+template <typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(const ExecutionPolicy& policy,
+                                      std::pmr::vector<Document>& documents,
+                                      size_t top_count) {
+    if (documents.size() > top_count) {
+        std::partial_sort(policy, documents.begin(),
+                          documents.begin() + top_count,
+                          documents.end(),
+                          IsMoreRelevant);
+        documents.resize(top_count);
+    } else {
+        std::sort(policy, documents.begin(), documents.end(),
+                  IsMoreRelevant);
     }
+}
 
+// FindAllDocuments
+template <typename Predicate>
+std::pmr::vector<Document>
+SearchServer::FindAllDocuments(const QueryTerms& terms,
+                               Predicate document_predicate,
+                               std::pmr::memory_resource* scratch) const {
+    std::pmr::vector<Document> matched_documents(scratch);
+    FindDocumentsInRange(terms, document_predicate, 0, documents_.size(),
+                         matched_documents, scratch);
     return matched_documents;
 }
 
 // FindAllDocuments sequenced_policy
 template <typename Predicate>
-std::vector<Document>
+std::pmr::vector<Document>
 SearchServer::FindAllDocuments(
               const std::execution::sequenced_policy& policy,
-              const Query& query,
-              Predicate document_predicate) const {
-    return FindAllDocuments(query, document_predicate);
+              const QueryTerms& terms,
+              Predicate document_predicate,
+              std::pmr::memory_resource* scratch) const {
+    return FindAllDocuments(terms, document_predicate, scratch);
 }
 
 // FindAllDocuments parallel_policy
+// The index space is cut into ranges and every range is scored by one
+// task over its own slice of the postings, so no two threads ever
+// touch the same document and nothing has to be locked. A task works in
+// the arena of its thread and copies its matches to scratch at the end;
+// only that copy is serialized, scratch is not thread-safe.
 template <typename Predicate>
-std::vector<Document>
+std::pmr::vector<Document>
 SearchServer::FindAllDocuments(
               const std::execution::parallel_policy& policy,
+              const QueryTerms& terms,
+              Predicate document_predicate,
+              std::pmr::memory_resource* scratch) const {
+    size_t posting_count = 0;
+    for (const PlusTerm& plus : terms.plus) {
+        posting_count += plus.postings->Size();
+    }
+    const int index_count = documents_.size();
+    const int range_count = std::clamp<int>(
+        posting_count / MIN_PARALLEL_RANGE_POSTINGS, 1,
+        4 * std::max(1u, std::thread::hardware_concurrency()));
+
+    std::pmr::vector<std::pmr::vector<Document>>
+    range_documents(range_count, scratch);
+    std::pmr::vector<int> ranges(range_count, scratch);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::mutex scratch_mutex;
+    for_each (policy,
+              ranges.begin(), ranges.end(),
+              [this, &terms, &document_predicate, &range_documents,
+               &scratch_mutex, index_count, range_count](int range) {
+                  const int first = static_cast<int64_t>(index_count)
+                                    * range / range_count;
+                  const int last = static_cast<int64_t>(index_count)
+                                   * (range + 1) / range_count;
+                  QueryArena arena;
+                  std::pmr::vector<Document> documents(arena.Resource());
+                  FindDocumentsInRange(terms, document_predicate,
+                                       first, last,
+                                       documents, arena.Resource());
+                  std::lock_guard guard(scratch_mutex);
+                  range_documents[range].assign(documents.begin(),
+                                                documents.end());
+              });
+
+    size_t matched_count = 0;
+    for (const auto& documents : range_documents) {
+        matched_count += documents.size();
+    }
+    std::pmr::vector<Document> matched_documents(scratch);
+    matched_documents.reserve(matched_count);
+    for (const auto& documents : range_documents) {
+        matched_documents.insert(matched_documents.end(),
+                                 documents.begin(), documents.end());
+    }
+    return matched_documents;
+}
+
+// FindDocumentsInRange
+template <typename Predicate>
+void SearchServer::FindDocumentsInRange(
+                   const QueryTerms& terms,
+                   Predicate& document_predicate,
+                   int first, int last,
+                   std::pmr::vector<Document>& matched_documents,
+                   std::pmr::memory_resource* scratch) const {
+    static thread_local ScoreAccumulator document_to_relevance;
+    document_to_relevance.Reserve(documents_.size());
+
+    // Documents with a minus-word are excluded before anything is
+    // scored, the plus-word scan skips them with one lookup.
+    IndexBitmap excluded_documents(scratch);
+    for (const PostingList* postings : terms.minus) {
+        postings->ForEachInRange(first, last,
+            [&excluded_documents](int index, uint32_t) {
+                excluded_documents.Add(index);
+            });
+    }
+
+    for (const auto& [_, postings, inverse_document_freq] : terms.plus) {
+        postings->ForEachInRange(first, last,
+            [this, &document_predicate, &excluded_documents,
+             inverse_document_freq]
+            (int index, uint32_t count) {
+                if (excluded_documents.Contains(index)) {
+                    return;
+                }
+                const auto& document_data = documents_[index];
+                if (!document_data.is_removed
+                    && document_predicate(document_data.id,
+                                          document_data.status,
+                                          document_data.rating)) {
+                    document_to_relevance.Add(index,
+                        ComputeTermFreq(count, document_data)
+                        * inverse_document_freq);
+                }
+            });
+    }
+
+    document_to_relevance.ForEach(
+        [this, &matched_documents](int index, double relevance) {
+            matched_documents.push_back(
+                { index, relevance, documents_[index].rating });
+        });
+    document_to_relevance.Clear();
+}
+
+// FindAllDocumentsWithAllWords
+template <typename Predicate>
+std::pmr::vector<Document>
+SearchServer::FindAllDocumentsWithAllWords(
               const Query& query,
-              Predicate document_predicate) const {
-    ConcurrentMap<int, double> relevances(CONCURRENT_MAP_BUCKETS);
+              Predicate document_predicate,
+              std::pmr::memory_resource* scratch) const {
+    std::pmr::vector<Document> matched_documents(scratch);
+    const QueryTerms terms = ResolveQueryTerms(query, scratch);
+    if (terms.plus.empty() || terms.plus.size() < query.plus_terms.size()) {
+        return matched_documents;
+    }
 
-    for_each (policy,
-              query.plus_words.begin(),
-              query.plus_words.end(),
-              [this, &relevances, &document_predicate]
-              (std::string_view word) {
-                  if (word_to_document_freqs_.count(word) == 0) {
-                      return;
-                  }
-                  const double
-                  idf = ComputeWordInverseDocumentFreq(word);
-
-                  for (const auto& [id, freq]
-                       : word_to_document_freqs_.at(word)) {
-                      const DocumentData doc = documents_.at(id);
-                      if (document_predicate(id, doc.status,
-                                             doc.rating)) {
-                          relevances[id].ref_to_value +=
-                              freq * idf;
-                      }
-                  }
+    // The candidates start as the rarest list and only shrink, each next
+    // list is decoded just in the blocks where candidates remain.
+    std::pmr::vector<const PostingList*> by_size(scratch);
+    by_size.reserve(terms.plus.size());
+    for (const PlusTerm& plus : terms.plus) {
+        by_size.push_back(plus.postings);
+    }
+    std::sort(by_size.begin(), by_size.end(),
+              [](const PostingList* lhs, const PostingList* rhs) {
+                  return lhs->Size() < rhs->Size();
               });
+    std::pmr::vector<uint32_t> indexes(scratch);
+    indexes.reserve(by_size.front()->Size());
+    by_size.front()->ForEachInRange(0, documents_.size(),
+        [&indexes](int index, uint32_t) {
+            indexes.push_back(index);
+        });
+    for (size_t i = 1; i < by_size.size() && !indexes.empty(); ++i) {
+        by_size[i]->Intersect(indexes);
+    }
+    for (const PostingList* postings : terms.minus) {
+        if (indexes.empty()) {
+            break;
+        }
+        postings->Subtract(indexes);
+    }
 
-    for_each (policy,
-              query.minus_words.begin(),
-              query.minus_words.end(),
-              [this, &relevances]
-              (std::string_view word) {
-                  if (word_to_document_freqs_.count(word) == 0) {
-                      return;
-                  }
-
-                  for (const auto& [id, _]
-                       : word_to_document_freqs_.at(word)) {
-                      relevances.Erase(id);
-                  }
+    std::pmr::vector<PostingList::Cursor> cursors(scratch);
+    cursors.reserve(terms.plus.size());
+    for (const PlusTerm& plus : terms.plus) {
+        cursors.emplace_back(*plus.postings);
+    }
+    for (const uint32_t index : indexes) {
+        const auto& document_data = documents_[index];
+        if (document_data.is_removed
+            || !document_predicate(document_data.id,
+                                   document_data.status,
+                                   document_data.rating)) {
+            continue;
+        }
+        // Summed in query word order, as FindAllDocuments does.
+        double relevance = 0.0;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            cursors[i].NextGEQ(index);
+            relevance += ComputeTermFreq(cursors[i].Count(), document_data)
+                         * terms.plus[i].inverse_document_freq;
+        }
+        matched_documents.push_back({ static_cast<int>(index), relevance,
+                                      document_data.rating });
+    }
+    return matched_documents;
+}
+
+// The sequential search is pruned, the parallel one scores every match
+// in ranges of documents.
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsForQuery(
+              const ExecutionPolicy& policy,
+              const QueryTerms& terms,
+              Predicate document_predicate,
+              size_t top_count,
+              std::pmr::memory_resource* scratch) const {
+    if constexpr (std::is_same_v<ExecutionPolicy,
+                                 std::execution::sequenced_policy>) {
+        return FindTopDocumentsPruned(terms, document_predicate,
+                                      top_count, scratch);
+    } else {
+        auto matched_documents = FindAllDocuments(policy, terms,
+                                                  document_predicate,
+                                                  scratch);
+        SelectTopDocuments(policy, matched_documents, top_count);
+        return ToExternalDocuments(matched_documents);
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocumentsWithStatus(
+              const ExecutionPolicy& policy,
+              const Query& query,
+              const QueryTerms* terms,
+              DocumentStatus status,
+              size_t top_count,
+              std::pmr::memory_resource* scratch) const {
+    const auto document_predicate = [status](int,
+                                             DocumentStatus document_status,
+                                             int) {
+                                        return document_status == status;
+                                    };
+    const auto find = [&] {
+        if (terms != nullptr) {
+            return FindTopDocumentsForQuery(policy, *terms,
+                                            document_predicate,
+                                            top_count, scratch);
+        }
+        return FindTopDocumentsForQuery(policy,
+                                        ResolveQueryTerms(query, scratch),
+                                        document_predicate,
+                                        top_count, scratch);
+    };
+    if (!query_cache_) {
+        return find();
+    }
+
+    const std::string key = MakeQueryCacheKey(query, status, top_count);
+    if (auto documents = query_cache_->Find(key, generation_)) {
+        return std::move(*documents);
+    }
+    auto documents = find();
+    query_cache_->Insert(key, generation_, documents);
+    return documents;
+}
+
+// FindTopDocumentsPruned
+template <typename Predicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsPruned(
+              const QueryTerms& query_terms,
+              Predicate document_predicate,
+              size_t top_count,
+              std::pmr::memory_resource* scratch) const {
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double idf;
+        double max_score;
+        size_t word_index;
+    };
+
+    if (top_count == 0) {
+        return {};
+    }
+
+    std::pmr::vector<TermCursor> terms(scratch);
+    terms.reserve(query_terms.plus.size());
+    for (size_t i = 0; i < query_terms.plus.size(); ++i) {
+        const auto& [_, postings, idf] = query_terms.plus[i];
+        terms.push_back({ PostingList::Cursor(*postings),
+                          idf, postings->MaxTermFreq() * idf, i });
+    }
+
+    IndexBitmap excluded_documents(scratch);
+    for (const PostingList* postings : query_terms.minus) {
+        postings->ForEachInRange(0, documents_.size(),
+            [&excluded_documents](int index, uint32_t) {
+                excluded_documents.Add(index);
+            });
+    }
+
+    // Terms sorted by their score bound, bounds[i] is the best score a
+    // document found only in terms[0..i] can get. Ties keep query order,
+    // without the buffer stable_sort would allocate.
+    std::sort(terms.begin(), terms.end(),
+              [](const TermCursor& lhs, const TermCursor& rhs) {
+                  return std::tie(lhs.max_score, lhs.word_index)
+                         < std::tie(rhs.max_score, rhs.word_index);
               });
+    std::pmr::vector<double> bounds(terms.size(), scratch);
+    double bound = 0.0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        bound += terms[i].max_score;
+        bounds[i] = bound;
+    }
 
-    std::vector<Document> matched_documents;
-    for (const auto [id, relevance] :
-         relevances.BuildOrdinaryMap()) {
-        matched_documents.push_back(
-            { id, relevance,
-              documents_.at(id).rating });
+    const auto advance = [](PostingList::Cursor& cursor, int index) {
+        cursor.NextGEQ(index);
+        return !cursor.IsEnd() && cursor.Index() == index;
+    };
+    const auto term_score = [this](const TermCursor& term) {
+        const uint32_t count = term.cursor.Count();
+        return ComputeTermFreq(count, documents_[term.cursor.Index()])
+               * term.idf;
+    };
+
+    // The heap front is the least relevant of the kept documents. A
+    // document cannot replace it while its score bound is below
+    // cutoff; the second MIN_REAL_VALUE covers rounding of the bounds.
+    std::pmr::vector<Document> top_documents(scratch);
+    top_documents.reserve(std::min(top_count, documents_.size()));
+    double cutoff = -std::numeric_limits<double>::infinity();
+    size_t first_essential = 0;
+    std::pmr::vector<double> scores(terms.size(), 0.0, scratch);
+
+    while (first_essential < terms.size()) {
+        int index = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            const PostingList::Cursor& cursor = terms[i].cursor;
+            if (!cursor.IsEnd()) {
+                index = std::min(index, cursor.Index());
+            }
+        }
+        if (index == std::numeric_limits<int>::max()) {
+            break;
+        }
+
+        // An excluded document is passed over before it is scored.
+        if (excluded_documents.Contains(index)) {
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                PostingList::Cursor& cursor = terms[i].cursor;
+                if (!cursor.IsEnd() && cursor.Index() == index) {
+                    cursor.Next();
+                }
+            }
+            continue;
+        }
+
+        double score = 0.0;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            TermCursor& term = terms[i];
+            if (!term.cursor.IsEnd() && term.cursor.Index() == index) {
+                scores[term.word_index] = term_score(term);
+                score += scores[term.word_index];
+                term.cursor.Next();
+            }
+        }
+
+        bool is_candidate = true;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (score + bounds[i] < cutoff) {
+                is_candidate = false;
+                break;
+            }
+            TermCursor& term = terms[i];
+            if (advance(term.cursor, index)) {
+                scores[term.word_index] = term_score(term);
+                score += scores[term.word_index];
+            }
+        }
+
+        // Summed in query word order, as FindAllDocuments does, so
+        // relevances match exhaustive scoring exactly.
+        double relevance = 0.0;
+        for (double& word_score : scores) {
+            relevance += word_score;
+            word_score = 0.0;
+        }
+        if (!is_candidate) {
+            continue;
+        }
+
+        const auto& document_data = documents_[index];
+        if (document_data.is_removed
+            || !document_predicate(document_data.id,
+                                   document_data.status,
+                                   document_data.rating)) {
+            continue;
+        }
+
+        const Document document(index, relevance,
+                                document_data.rating);
+        if (top_documents.size() < top_count) {
+            top_documents.push_back(document);
+            std::push_heap(top_documents.begin(), top_documents.end(),
+                           IsMoreRelevant);
+        } else if (IsMoreRelevant(document, top_documents.front())) {
+            std::pop_heap(top_documents.begin(), top_documents.end(),
+                          IsMoreRelevant);
+            top_documents.back() = document;
+            std::push_heap(top_documents.begin(), top_documents.end(),
+                           IsMoreRelevant);
+        }
+
+        if (top_documents.size() == top_count) {
+            cutoff = top_documents.front().relevance
+                     - 2 * MIN_REAL_VALUE;
+            while (first_essential < terms.size()
+                   && bounds[first_essential] < cutoff) {
+                ++first_essential;
+            }
+        }
     }
 
-    return matched_documents;
-}
\ No newline at end of file
+    std::sort(top_documents.begin(), top_documents.end(),
+              IsMoreRelevant);
+    return ToExternalDocuments(top_documents);
+}
+
+// Prepared queries
+template <typename Function>
+auto SearchServer::WithPreparedQuery(const PreparedQuery& prepared,
+                                     std::pmr::memory_resource* scratch,
+                                     Function function) const {
+    if (prepared.server_ == this && prepared.generation_ == generation_) {
+        return function(prepared.query_, prepared.terms_);
+    }
+    const Query query = LookUpQueryWords(prepared, scratch);
+    return function(query, ResolveQueryTerms(query, scratch));
+}
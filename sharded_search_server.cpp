@@ -0,0 +1,75 @@
+#include "sharded_search_server.h"
+
+// PUBLIC
+
+void ShardedSearchServer::AddDocument(int document_id,
+                          const std::string_view document,
+                          DocumentStatus status,
+                          const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("Invalid document_id");
+    }
+    GetShard(document_id).AddDocument(document_id, document,
+                                      status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    GetShard(document_id).RemoveDocument(document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+// FindTopDocuments
+std::vector<Document>
+ShardedSearchServer::FindTopDocuments(
+                     const std::string_view raw_query,
+                     DocumentStatus status,
+                     size_t top_count) const {
+    return FindTopDocuments(raw_query,
+           [status](int,
+                    DocumentStatus document_status,
+                    int) {
+                        return document_status == status;
+                    },
+           top_count);
+}
+
+std::vector<Document>
+ShardedSearchServer::FindTopDocuments(
+                     const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+// MatchDocument
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+ShardedSearchServer::MatchDocument(const std::string_view raw_query,
+                                   int document_id) const {
+    if (document_id < 0) {
+        throw std::invalid_argument("document_id out of range"s);
+    }
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+// PRIVATE
+
+const SearchServer&
+ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[document_id % shards_.size()];
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[document_id % shards_.size()];
+}
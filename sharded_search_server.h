@@ -0,0 +1,114 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <vector>
+
+// Documents are partitioned by id across independent SearchServer
+// shards. A query is run on all shards in parallel with the IDF of the
+// whole collection, so the merged ranking is the one a single server
+// holding every document would give.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words,
+                        size_t shard_count);
+
+    void AddDocument(int document_id,
+                     const std::string_view document,
+                     DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+// FindTopDocuments
+    template <typename Predicate>
+    std::vector<Document>
+    FindTopDocuments(const std::string_view raw_query,
+                     Predicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(const std::string_view raw_query,
+                     DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(const std::string_view raw_query) const;
+
+// MatchDocument
+    std::tuple<std::vector<std::string_view>, DocumentStatus>
+    MatchDocument(const std::string_view raw_query, int document_id) const;
+
+private:
+    // Shards keep string_views into their own vocabulary, so they are
+    // created in place once and never moved.
+    std::vector<SearchServer> shards_;
+
+    const SearchServer& GetShard(int document_id) const;
+
+    SearchServer& GetShard(int document_id);
+};
+
+// PUBLIC
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(
+                     const StringContainer& stop_words,
+                     size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+// FindTopDocuments
+template <typename Predicate>
+std::vector<Document>
+ShardedSearchServer::FindTopDocuments(
+                     const std::string_view raw_query,
+                     Predicate document_predicate,
+                     size_t top_count) const {
+    // Collected sequentially: a malformed query throws here and not
+    // inside the parallel algorithm below.
+    CorpusStatistics statistics;
+    for (const SearchServer& shard : shards_) {
+        statistics += shard.GetCorpusStatistics(raw_query);
+    }
+
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par,
+                   shards_.begin(), shards_.end(),
+                   shard_documents.begin(),
+                   [&statistics, raw_query, &document_predicate,
+                    top_count](const SearchServer& shard) {
+                       return shard.FindTopDocuments(statistics,
+                                                     raw_query,
+                                                     document_predicate,
+                                                     top_count);
+                   });
+
+    std::vector<Document> matched_documents;
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(),
+                                 documents.begin(), documents.end());
+    }
+    if (matched_documents.size() > top_count) {
+        std::partial_sort(matched_documents.begin(),
+                          matched_documents.begin() + top_count,
+                          matched_documents.end(),
+                          IsMoreRelevant);
+        matched_documents.resize(top_count);
+    } else {
+        std::sort(matched_documents.begin(), matched_documents.end(),
+                  IsMoreRelevant);
+    }
+    return matched_documents;
+}
@@ -0,0 +1,303 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+const size_t SECTION_COUNT =
+    static_cast<size_t>(SnapshotSectionId::SECTION_COUNT);
+const uint64_t SECTIONS_OFFSET = sizeof(SnapshotHeader);
+const uint64_t DATA_OFFSET = SECTIONS_OFFSET
+                             + SECTION_COUNT * sizeof(SnapshotSection);
+
+#ifdef _WIN32
+
+void SyncFile(const std::string& path) {
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE,
+                                    FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open "s + path);
+    }
+    const bool is_synced = FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!is_synced) {
+        throw std::runtime_error("Cannot sync "s + path);
+    }
+}
+
+void ReplaceFile(const std::string& from, const std::string& to) {
+    if (!MoveFileExA(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw std::runtime_error("Cannot rename "s + from + " to "s + to);
+    }
+}
+
+#else
+
+void SyncFile(const std::string& path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Cannot open "s + path);
+    }
+    const bool is_synced = fsync(file) == 0;
+    close(file);
+    if (!is_synced) {
+        throw std::runtime_error("Cannot sync "s + path);
+    }
+}
+
+// The rename itself is made durable by syncing the directory.
+void ReplaceFile(const std::string& from, const std::string& to) {
+    if (std::rename(from.c_str(), to.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename "s + from + " to "s + to);
+    }
+    const size_t slash = to.find_last_of('/');
+    SyncFile(slash == std::string::npos ? "."s
+             : slash == 0 ? "/"s : to.substr(0, slash));
+}
+
+#endif
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t ComputeChecksum(const void* data, size_t size) {
+    SnapshotChecksum checksum;
+    checksum.Update(data, size);
+    return checksum.Value();
+}
+
+uint64_t ComputeHeaderChecksum(SnapshotHeader header,
+                               const std::vector<SnapshotSection>& sections) {
+    header.checksum = 0;
+    SnapshotChecksum checksum;
+    checksum.Update(&header, sizeof(header));
+    checksum.Update(sections.data(),
+                    sections.size() * sizeof(SnapshotSection));
+    return checksum.Value();
+}
+
+} // namespace
+
+// SnapshotChecksum
+
+void SnapshotChecksum::Update(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    length_ += size;
+    while (size > 0 && pending_size_ > 0) {
+        pending_[pending_size_++] = *bytes++;
+        --size;
+        if (pending_size_ == sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, pending_, sizeof(word));
+            Mix(word);
+            pending_size_ = 0;
+        }
+    }
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        Mix(word);
+        bytes += sizeof(uint64_t);
+    }
+    std::memcpy(pending_ + pending_size_, bytes, size);
+    pending_size_ += size;
+}
+
+uint64_t SnapshotChecksum::Value() const {
+    SnapshotChecksum last = *this;
+    uint64_t word = 0;
+    std::memcpy(&word, pending_, pending_size_);
+    last.Mix(word);
+    last.Mix(length_);
+    uint64_t value = last.state_;
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    return value;
+}
+
+void SnapshotChecksum::Mix(uint64_t word) {
+    state_ ^= RotateLeft(word * 0xC2B2AE3D27D4EB4Full, 31)
+              * 0x9E3779B185EBCA87ull;
+    state_ = RotateLeft(state_, 27) * 0x9E3779B185EBCA87ull
+             + 0x85EBCA77C2B2AE63ull;
+}
+
+// SnapshotWriter
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temp_path_(path + ".tmp"s)
+    , out_(temp_path_, std::ios::binary | std::ios::trunc)
+    , sections_(SECTION_COUNT, SnapshotSection{ 0, 0, 0 })
+{
+    Check();
+    const std::vector<char> placeholder(DATA_OFFSET, 0);
+    out_.write(placeholder.data(), placeholder.size());
+    position_ = DATA_OFFSET;
+    Check();
+}
+
+void SnapshotWriter::BeginSection(SnapshotSectionId id) {
+    EndSection();
+    static const char padding[8] = {};
+    const size_t padding_size = (8 - position_ % 8) % 8;
+    out_.write(padding, padding_size);
+    position_ += padding_size;
+    current_ = id;
+    sections_[static_cast<size_t>(id)].offset = position_;
+    checksum_ = SnapshotChecksum();
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    checksum_.Update(data, size);
+    position_ += size;
+    sections_[static_cast<size_t>(current_)].size += size;
+}
+
+void SnapshotWriter::Finish(uint64_t log_sequence_number) {
+    EndSection();
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.section_count = SECTION_COUNT;
+    header.file_size = position_;
+    header.log_sequence_number = log_sequence_number;
+    header.checksum = ComputeHeaderChecksum(header, sections_);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char*>(sections_.data()),
+               sections_.size() * sizeof(SnapshotSection));
+    out_.close();
+    Check();
+    SyncFile(temp_path_);
+    ReplaceFile(temp_path_, path_);
+    is_finished_ = true;
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!is_finished_) {
+        out_.close();
+        std::remove(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::EndSection() {
+    if (current_ != SnapshotSectionId::SECTION_COUNT) {
+        sections_[static_cast<size_t>(current_)].checksum =
+            checksum_.Value();
+    }
+    current_ = SnapshotSectionId::SECTION_COUNT;
+    Check();
+}
+
+void SnapshotWriter::Check() {
+    if (!out_) {
+        throw std::runtime_error("Cannot write snapshot "s + path_);
+    }
+}
+
+// SnapshotReader
+
+SnapshotReader::SnapshotReader(const MappedFile& file,
+                               bool verify_block_data)
+    : file_(file)
+{
+    if (file.Size() < DATA_OFFSET) {
+        throw std::runtime_error("Not a search server snapshot"s);
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC,
+                    sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a search server snapshot"s);
+    }
+    if (header.version != SNAPSHOT_VERSION
+        || header.section_count != SECTION_COUNT) {
+        throw std::runtime_error("Unsupported snapshot version "s
+                                 + std::to_string(header.version));
+    }
+    if (header.file_size != file.Size()) {
+        throw std::runtime_error("Truncated snapshot"s);
+    }
+
+    sections_.resize(SECTION_COUNT);
+    std::memcpy(sections_.data(), file.Data() + SECTIONS_OFFSET,
+                SECTION_COUNT * sizeof(SnapshotSection));
+    if (ComputeHeaderChecksum(header, sections_) != header.checksum) {
+        throw std::runtime_error("Damaged snapshot header"s);
+    }
+    log_sequence_number_ = header.log_sequence_number;
+    for (size_t i = 0; i < SECTION_COUNT; ++i) {
+        const SnapshotSection& section = sections_[i];
+        if (section.offset % 8 != 0 || section.offset < DATA_OFFSET
+            || section.offset > file.Size()
+            || section.size > file.Size() - section.offset) {
+            throw std::runtime_error("Damaged snapshot header"s);
+        }
+        if (i == static_cast<size_t>(SnapshotSectionId::BLOCK_DATA)
+            && !verify_block_data) {
+            continue;
+        }
+        if (ComputeChecksum(file.Data() + section.offset, section.size)
+            != section.checksum) {
+            throw std::runtime_error("Damaged snapshot section "s
+                                     + std::to_string(i));
+        }
+    }
+}
+
+uint64_t SnapshotReader::GetLogSequenceNumber() const {
+    return log_sequence_number_;
+}
+
+std::vector<std::string_view>
+SnapshotReader::GetStrings(SnapshotSectionId id) const {
+    const SnapshotSection& section = sections_[static_cast<size_t>(id)];
+    const uint8_t* data = file_.Data() + section.offset;
+    uint64_t count = 0;
+    if (section.size >= sizeof(count)) {
+        std::memcpy(&count, data, sizeof(count));
+    }
+    const uint64_t table_size = (count + 2) * sizeof(uint64_t);
+    if (count > section.size / sizeof(uint64_t)
+        || table_size > section.size) {
+        throw std::runtime_error("Damaged snapshot section"s);
+    }
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(
+                              data + sizeof(count));
+    const char* chars = reinterpret_cast<const char*>(data + table_size);
+    const uint64_t chars_size = section.size - table_size;
+    std::vector<std::string_view> strings;
+    strings.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > chars_size) {
+            throw std::runtime_error("Damaged snapshot section"s);
+        }
+        strings.emplace_back(chars + offsets[i],
+                             offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary snapshot of a SearchServer, see SearchServer::SaveSnapshot.
+//
+// The file is a SnapshotHeader, a table of SECTION_COUNT sections and
+// the sections themselves, each starting at a multiple of 8 so arrays
+// can be read in place from a mapping. Integers are stored in host byte
+// order; a snapshot is only meant to be read on the kind of machine
+// that wrote it. Every section has its own checksum, the header has one
+// over itself and the section table.
+
+const uint32_t SNAPSHOT_VERSION = 3;
+
+// What SearchServer::LoadSnapshot checks against the checksums:
+// everything, or all but the compressed posting bytes, which are then
+// left to be faulted in on use. A damaged block decodes to arbitrary
+// document indexes that queries use unchecked, so METADATA is only for
+// files known to be intact, e.g. one the process has just written.
+enum class SnapshotVerification {
+    METADATA,
+    FULL
+};
+
+enum class SnapshotSectionId : uint32_t {
+    STOP_WORDS,      // string table
+    WORDS,           // string table, the dictionary in term id order
+    DOCUMENTS,       // SnapshotDocument per internal index
+    POSTING_LISTS,   // SnapshotPostingList per dictionary word
+    BLOCKS,          // PostingList::Block
+    BLOCK_DATA,      // compressed block bytes
+    TAIL_INDEXES,    // int32_t
+    TAIL_COUNTS,     // uint32_t
+    FORWARD_OFFSETS, // uint64_t per document and one past the end
+    FORWARD_WORDS,   // uint32_t term ids
+    FORWARD_FREQS,   // double
+    SECTION_COUNT
+};
+
+// A string table is a uint64_t count, count + 1 uint64_t offsets into
+// the characters and the characters.
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t file_size;
+    // Last write-ahead log record the snapshot includes.
+    uint64_t log_sequence_number;
+    uint64_t checksum;
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+struct SnapshotDocument {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    int32_t is_live;
+    double inv_word_count;
+};
+
+// Blocks, block bytes and tail of one word, as positions in the shared
+// sections. A word without postings has size 0.
+struct SnapshotPostingList {
+    uint64_t first_block;
+    uint64_t block_count;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t first_tail;
+    uint64_t tail_size;
+    uint64_t size;
+    uint64_t removed_size;
+    double max_term_freq;
+};
+
+// 64-bit checksum fed in pieces, the value only depends on the bytes.
+class SnapshotChecksum {
+public:
+    void Update(const void* data, size_t size);
+
+    uint64_t Value() const;
+
+private:
+    uint64_t state_ = 0x9E3779B97F4A7C15ull;
+    uint64_t length_ = 0;
+    uint8_t pending_[8] = {};
+    size_t pending_size_ = 0;
+
+    void Mix(uint64_t word);
+};
+
+// Writes the sections one after another, then the header and the
+// table. Everything goes to path + ".tmp", which Finish syncs and
+// renames over path, so a file at path is never cut short: a crash
+// mid-save leaves the previous snapshot, and a server mapping it keeps
+// reading the old file. Throws std::runtime_error on I/O errors.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Removes the temporary file of an unfinished snapshot.
+    ~SnapshotWriter();
+
+    void BeginSection(SnapshotSectionId id);
+
+    void Write(const void* data, size_t size);
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values);
+
+    template <typename StringContainer>
+    void WriteStrings(SnapshotSectionId id,
+                      const StringContainer& strings);
+
+    void Finish(uint64_t log_sequence_number);
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    std::vector<SnapshotSection> sections_;
+    SnapshotSectionId current_ = SnapshotSectionId::SECTION_COUNT;
+    SnapshotChecksum checksum_;
+    uint64_t position_ = 0;
+    bool is_finished_ = false;
+
+    void EndSection();
+
+    void Check();
+};
+
+// Sections of a mapped snapshot. The constructor checks the header and
+// the checksums of every section but BLOCK_DATA, which is only read
+// through when verify_block_data is set. Throws std::runtime_error on a
+// damaged or foreign file.
+class SnapshotReader {
+public:
+    template <typename T>
+    struct Array {
+        const T* data = nullptr;
+        size_t size = 0;
+
+        const T& operator[](size_t i) const {
+            return data[i];
+        }
+    };
+
+    SnapshotReader(const MappedFile& file, bool verify_block_data);
+
+    template <typename T>
+    Array<T> GetArray(SnapshotSectionId id) const;
+
+    std::vector<std::string_view> GetStrings(SnapshotSectionId id) const;
+
+    uint64_t GetLogSequenceNumber() const;
+
+private:
+    const MappedFile& file_;
+    std::vector<SnapshotSection> sections_;
+    uint64_t log_sequence_number_ = 0;
+};
+
+template <typename T>
+void SnapshotWriter::WriteArray(const std::vector<T>& values) {
+    Write(values.data(), values.size() * sizeof(T));
+}
+
+template <typename StringContainer>
+void SnapshotWriter::WriteStrings(SnapshotSectionId id,
+                                  const StringContainer& strings) {
+    BeginSection(id);
+    std::vector<uint64_t> offsets{ 0 };
+    for (const auto& string : strings) {
+        offsets.push_back(offsets.back() + string.size());
+    }
+    const uint64_t count = offsets.size() - 1;
+    Write(&count, sizeof(count));
+    WriteArray(offsets);
+    for (const auto& string : strings) {
+        Write(string.data(), string.size());
+    }
+}
+
+template <typename T>
+SnapshotReader::Array<T>
+SnapshotReader::GetArray(SnapshotSectionId id) const {
+    const SnapshotSection& section = sections_[static_cast<size_t>(id)];
+    if (section.size % sizeof(T) != 0) {
+        throw std::runtime_error("Damaged snapshot section");
+    }
+    return { reinterpret_cast<const T*>(file_.Data() + section.offset),
+             static_cast<size_t>(section.size / sizeof(T)) };
+}
@@ -0,0 +1,143 @@
+#include "sorted_set.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SORTED_SET_SSE2
+#endif
+
+namespace {
+
+#ifdef SORTED_SET_SSE2
+
+// Bit k is set when a[k] equals one of the four values of b.
+int MatchMask(__m128i a, __m128i b) {
+    const __m128i rotated_1 = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+    const __m128i rotated_2 = _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128i rotated_3 = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3));
+    const __m128i equal = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, rotated_1)),
+        _mm_or_si128(_mm_cmpeq_epi32(a, rotated_2),
+                     _mm_cmpeq_epi32(a, rotated_3)));
+    return _mm_movemask_ps(_mm_castsi128_ps(equal));
+}
+
+__m128i Load(const uint32_t* values) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+}
+
+#endif
+
+} // namespace
+
+size_t IntersectSorted(const uint32_t* a, size_t a_size,
+                       const uint32_t* b, size_t b_size,
+                       uint32_t* out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+#ifdef SORTED_SET_SSE2
+    while (i + 4 <= a_size && j + 4 <= b_size) {
+        const int mask = MatchMask(Load(a + i), Load(b + j));
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) {
+                out[count++] = a[i + k];
+            }
+        }
+        const uint32_t a_max = a[i + 3];
+        const uint32_t b_max = b[j + 3];
+        i += a_max <= b_max ? 4 : 0;
+        j += b_max <= a_max ? 4 : 0;
+    }
+#endif
+    while (i < a_size && j < b_size) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            out[count++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
+
+size_t SubtractSorted(const uint32_t* a, size_t a_size,
+                      const uint32_t* b, size_t b_size,
+                      uint32_t* out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+#ifdef SORTED_SET_SSE2
+    // Matches of the current four values of a are collected over all
+    // windows of b they overlap and flushed when a moves on.
+    int matched = 0;
+    while (i + 4 <= a_size && j + 4 <= b_size) {
+        matched |= MatchMask(Load(a + i), Load(b + j));
+        const uint32_t a_max = a[i + 3];
+        const uint32_t b_max = b[j + 3];
+        if (a_max <= b_max) {
+            for (int k = 0; k < 4; ++k) {
+                if (!(matched & (1 << k))) {
+                    out[count++] = a[i + k];
+                }
+            }
+            matched = 0;
+            i += 4;
+        }
+        j += b_max <= a_max ? 4 : 0;
+    }
+    // A partially compared window of a is finished by the scalar loop;
+    // rewind to it and skip the values already found in b.
+    if (matched != 0) {
+        for (int k = 0; k < 4; ++k) {
+            if (matched & (1 << k)) {
+                continue;
+            }
+            const uint32_t value = a[i + k];
+            while (j < b_size && b[j] < value) {
+                ++j;
+            }
+            if (j == b_size || b[j] != value) {
+                out[count++] = value;
+            }
+        }
+        i += 4;
+    }
+#endif
+    while (i < a_size) {
+        while (j < b_size && b[j] < a[i]) {
+            ++j;
+        }
+        if (j == b_size || b[j] != a[i]) {
+            out[count++] = a[i];
+        }
+        ++i;
+    }
+    return count;
+}
+
+size_t LowerBoundSorted(const uint32_t* values, size_t size,
+                        uint32_t target) {
+    size_t i = 0;
+#ifdef SORTED_SET_SSE2
+    // Sorted input: the position is the number of smaller values, and
+    // whole groups of four can be counted with one compare.
+    const __m128i bound = _mm_set1_epi32(static_cast<int>(target));
+    for (; i + 4 <= size; i += 4) {
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmplt_epi32(Load(values + i), bound)));
+        if (mask != 0xF) {
+            for (; mask & 1; mask >>= 1) {
+                ++i;
+            }
+            return i;
+        }
+    }
+#endif
+    return std::lower_bound(values + i, values + size, target) - values;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Operations on strictly increasing uint32_t arrays, such as decoded
+// posting blocks. On x86 they compare four values against four with
+// SSE2; the other targets use the scalar merge.
+
+// Writes the values of a that are also in b to out, returns how many.
+size_t IntersectSorted(const uint32_t* a, size_t a_size,
+                       const uint32_t* b, size_t b_size,
+                       uint32_t* out);
+
+// Writes the values of a that are not in b to out, returns how many.
+size_t SubtractSorted(const uint32_t* a, size_t a_size,
+                      const uint32_t* b, size_t b_size,
+                      uint32_t* out);
+
+// Position of the first value not less than target. Values must stay
+// below 2^31.
+size_t LowerBoundSorted(const uint32_t* values, size_t size,
+                        uint32_t target);
@@ -1,19 +1,129 @@
 #include "string_processing.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define STRING_PROCESSING_X86
+#define STRING_PROCESSING_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STRING_PROCESSING_X86
+#define STRING_PROCESSING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+using ClassifyFunction = TextBlockMasks (*)(const char*);
+
+// Control characters are the bytes below ' ', as IsValidWord has it.
+TextBlockMasks ClassifyScalar(const char* data, size_t size) {
+    TextBlockMasks masks;
+    for (size_t i = 0; i < size; ++i) {
+        const auto c = static_cast<unsigned char>(data[i]);
+        masks.spaces |= static_cast<uint64_t>(c == ' ') << i;
+        masks.invalid |= static_cast<uint64_t>(c < ' ') << i;
+    }
+    return masks;
+}
+
+#ifdef STRING_PROCESSING_X86
+
+// A byte is below ' ' when the unsigned minimum with ' ' - 1 leaves it
+// unchanged.
+uint32_t InvalidMask16(__m128i bytes) {
+    const __m128i bound = _mm_set1_epi8(' ' - 1);
+    return _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(bytes, bound), bytes));
+}
+
+uint32_t SpaceMask16(__m128i bytes) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+}
+
+TextBlockMasks ClassifySse2(const char* data) {
+    TextBlockMasks masks;
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 16) {
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        masks.spaces |= static_cast<uint64_t>(SpaceMask16(bytes)) << i;
+        masks.invalid |= static_cast<uint64_t>(InvalidMask16(bytes)) << i;
+    }
+    return masks;
+}
+
+bool HasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+STRING_PROCESSING_TARGET_AVX2
+TextBlockMasks ClassifyAvx2(const char* data) {
+    const __m256i bound = _mm256_set1_epi8(' ' - 1);
+    const __m256i space = _mm256_set1_epi8(' ');
+    TextBlockMasks masks;
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 32) {
+        const __m256i bytes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const uint32_t spaces = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(bytes, space));
+        const uint32_t invalid = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, bound), bytes));
+        masks.spaces |= static_cast<uint64_t>(spaces) << i;
+        masks.invalid |= static_cast<uint64_t>(invalid) << i;
+    }
+    return masks;
+}
+
+#endif
+
+// SSE2 is part of every x86-64 CPU, it is the baseline on x86.
+ClassifyFunction SelectClassifier() {
+#ifdef STRING_PROCESSING_X86
+    return HasAvx2() ? ClassifyAvx2 : ClassifySse2;
+#else
+    return [](const char* data) {
+        return ClassifyScalar(data, TEXT_BLOCK_SIZE);
+    };
+#endif
+}
+
+ClassifyFunction GetClassifier() {
+    static const ClassifyFunction classifier = SelectClassifier();
+    return classifier;
+}
+
+} // namespace
+
 std::vector<std::string_view>
 SplitIntoWords(std::string_view str) {
     std::vector<std::string_view> result;
-    const int64_t pos_end = str.npos;
-    while (true) {
-        int64_t space = str.find(' ');
-        result.push_back(space == pos_end ? str.substr() :
-                         str.substr(0, space));
-        if (space == pos_end) {
-            break;
-        } else {
-            ++space;
-            str.remove_prefix(space);
-        }
-    }
+    ForEachWord(str, [&result](std::string_view word, bool) {
+        result.push_back(word);
+    });
     return result;
+}
+
+// The kernels read whole blocks, the short last block of a text is
+// left to the scalar loop.
+TextBlockMasks ClassifyTextBlock(const char* data, size_t size) {
+    if (size == TEXT_BLOCK_SIZE) {
+        return GetClassifier()(data);
+    }
+    return ClassifyScalar(data, size);
+}
+
+const char* TextKernelName() {
+#ifdef STRING_PROCESSING_X86
+    if (GetClassifier() == ClassifyAvx2) {
+        return "avx2";
+    }
+    if (GetClassifier() == ClassifySse2) {
+        return "sse2";
+    }
+#endif
+    return "scalar";
 }
\ No newline at end of file
@@ -1,13 +1,73 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <set>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 std::vector<std::string_view>
 SplitIntoWords(std::string_view str);
 
+// Spaces and control characters of up to TEXT_BLOCK_SIZE bytes of
+// text, bit i stands for data[i]. The blocks are classified with AVX2
+// or SSE2 when the CPU has them and by scalar code otherwise; bits past
+// size are clear.
+const size_t TEXT_BLOCK_SIZE = 64;
+
+struct TextBlockMasks {
+    uint64_t spaces = 0;
+    uint64_t invalid = 0;
+};
+
+TextBlockMasks ClassifyTextBlock(const char* data, size_t size);
+
+// Name of the classification kernel picked for this CPU.
+const char* TextKernelName();
+
+inline int LowestBitIndex(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Calls function(word, is_valid) for every word SplitIntoWords would
+// return, in order, without collecting them. is_valid is false for a
+// word with a control character. Separators and invalid bytes are
+// found in the same pass over each block.
+template <typename Function>
+void ForEachWord(std::string_view str, Function function) {
+    size_t word_begin = 0;
+    bool is_valid = true;
+    for (size_t block = 0; block < str.size(); block += TEXT_BLOCK_SIZE) {
+        auto [spaces, invalid] = ClassifyTextBlock(
+            str.data() + block,
+            std::min(TEXT_BLOCK_SIZE, str.size() - block));
+        while (spaces != 0) {
+            const uint64_t before_space = (spaces & (~spaces + 1)) - 1;
+            const size_t space = block + LowestBitIndex(spaces);
+            function(str.substr(word_begin, space - word_begin),
+                     is_valid && (invalid & before_space) == 0);
+            invalid &= ~before_space;
+            spaces &= spaces - 1;
+            word_begin = space + 1;
+            is_valid = true;
+        }
+        is_valid = is_valid && invalid == 0;
+    }
+    function(str.substr(word_begin), is_valid);
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>>
 MakeUniqueNonEmptyStrings(StringContainer& container) {
@@ -0,0 +1,98 @@
+#include "term_interner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// PUBLIC
+
+TermInterner::TermInterner(const TermInterner& other) {
+    terms_.reserve(other.terms_.size());
+    hashes_.reserve(other.hashes_.size());
+    for (const std::string_view word : other.terms_) {
+        Intern(word);
+    }
+}
+
+TermInterner& TermInterner::operator=(const TermInterner& other) {
+    if (this != &other) {
+        TermInterner copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+uint32_t TermInterner::Intern(std::string_view word) {
+    // At most half of the slots are used, probe chains stay short.
+    if (2 * (terms_.size() + 1) > slots_.size()) {
+        Rehash(std::max(MIN_SLOT_COUNT, 2 * slots_.size()));
+    }
+    const uint64_t hash = Hash(word);
+    const size_t slot = FindSlot(word, hash);
+    if (slots_[slot] != NO_TERM) {
+        return slots_[slot];
+    }
+
+    const uint32_t id = terms_.size();
+    terms_.push_back(Store(word));
+    hashes_.push_back(hash);
+    slots_[slot] = id;
+    return id;
+}
+
+uint32_t TermInterner::Find(std::string_view word) const {
+    if (slots_.empty()) {
+        return NO_TERM;
+    }
+    return slots_[FindSlot(word, Hash(word))];
+}
+
+std::string_view TermInterner::GetTerm(uint32_t id) const {
+    return terms_[id];
+}
+
+size_t TermInterner::Size() const {
+    return terms_.size();
+}
+
+// PRIVATE
+
+uint64_t TermInterner::Hash(std::string_view word) {
+    return std::hash<std::string_view>{}(word);
+}
+
+size_t TermInterner::FindSlot(std::string_view word, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = hash & mask;
+    while (slots_[slot] != NO_TERM
+           && (hashes_[slots_[slot]] != hash
+               || terms_[slots_[slot]] != word)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Words longer than a chunk get a chunk of their own.
+std::string_view TermInterner::Store(std::string_view word) {
+    if (word.size() > chunk_free_) {
+        chunk_free_ = std::max(CHUNK_SIZE, word.size());
+        chunk_next_ = chunks_.emplace_back(new char[chunk_free_]).get();
+    }
+    char* data = chunk_next_;
+    std::memcpy(data, word.data(), word.size());
+    chunk_next_ += word.size();
+    chunk_free_ -= word.size();
+    return { data, word.size() };
+}
+
+void TermInterner::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, NO_TERM);
+    const size_t mask = slot_count - 1;
+    for (uint32_t id = 0; id < terms_.size(); ++id) {
+        size_t slot = hashes_[id] & mask;
+        while (slots_[slot] != NO_TERM) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = id;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Vocabulary of a SearchServer. Every distinct word gets a dense id in
+// the order it is first interned; the bytes of the words are packed
+// into arena chunks that never move, so the views GetTerm returns stay
+// valid as long as the interner, also when it is moved. Ids are looked
+// up in an open addressing table with linear probing that keeps the id
+// of a word in each used slot and compares the stored hash before the
+// bytes.
+class TermInterner {
+public:
+    static constexpr uint32_t NO_TERM = UINT32_MAX;
+
+    TermInterner() = default;
+
+    // The copy has the same ids, its words live in its own arena.
+    TermInterner(const TermInterner& other);
+
+    TermInterner& operator=(const TermInterner& other);
+
+    TermInterner(TermInterner&&) = default;
+
+    TermInterner& operator=(TermInterner&&) = default;
+
+    // Id of word, which is added when it is new.
+    uint32_t Intern(std::string_view word);
+
+    // NO_TERM for a word that was never interned.
+    uint32_t Find(std::string_view word) const;
+
+    std::string_view GetTerm(uint32_t id) const;
+
+    size_t Size() const;
+
+    auto begin() const {
+        return terms_.begin();
+    }
+
+    auto end() const {
+        return terms_.end();
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MIN_SLOT_COUNT = 16;
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* chunk_next_ = nullptr;
+    size_t chunk_free_ = 0;
+    std::vector<std::string_view> terms_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> slots_;
+
+    static uint64_t Hash(std::string_view word);
+
+    // Slot of word or the empty slot where it would go.
+    size_t FindSlot(std::string_view word, uint64_t hash) const;
+
+    std::string_view Store(std::string_view word);
+
+    void Rehash(size_t slot_count);
+};
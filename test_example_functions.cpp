@@ -55,6 +55,52 @@ GenerateQueries(std::mt19937& generator,
     return queries;
 }
 
+std::vector<std::string>
+GenerateSkewedQueries(std::mt19937& generator,
+                      const std::vector<std::string>& queries,
+                      int count) {
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const double position = std::pow(distribution(generator), 5.0);
+        result.push_back(queries[static_cast<size_t>(position
+                                                     * queries.size())]);
+    }
+    return result;
+}
+
+std::vector<std::string>
+GenerateNearCopies(std::mt19937& generator,
+                   const std::vector<std::string>& documents,
+                   const std::vector<std::string>& dictionary,
+                   int copy_count, int changed_count) {
+    std::vector<std::string> copies;
+    copies.reserve(copy_count);
+    for (int i = 0; i < copy_count; ++i) {
+        const std::string& document = documents[
+            std::uniform_int_distribution<int>(0, documents.size() - 1)(
+                generator)];
+        const auto words = SplitIntoWords(document);
+        std::vector<std::string> copy(words.begin(), words.end());
+        for (int j = 0; j < changed_count; ++j) {
+            copy[std::uniform_int_distribution<int>(0, copy.size() - 1)(
+                 generator)] =
+                dictionary[std::uniform_int_distribution<int>(0,
+                           dictionary.size() - 1)(generator)];
+        }
+        std::string text;
+        for (const std::string& word : copy) {
+            if (!text.empty()) {
+                text.push_back(' ');
+            }
+            text += word;
+        }
+        copies.push_back(std::move(text));
+    }
+    return copies;
+}
+
 std::string
 GenerateQuery2(std::mt19937& generator,
                const std::vector<std::string>& dictionary,
@@ -84,4 +130,216 @@ GenerateQueries2(std::mt19937& generator,
                                         max_word_count));
     }
     return queries;
-}
\ No newline at end of file
+}
+
+void Test_Add_Document(std::string_view mark,
+                       const std::string& stop_words,
+                       const std::vector<std::string>& documents) {
+    LOG_DURATION(mark);
+    SearchServer search_server(stop_words);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i],
+                                  DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    std::cout << search_server.GetDocumentCount() << std::endl;
+}
+
+void Test_Add_Documents(std::string_view mark,
+                        const std::string& stop_words,
+                        const std::vector<std::string>& documents) {
+    LOG_DURATION(mark);
+    SearchServer search_server(stop_words);
+    std::vector<DocumentInput> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({ static_cast<int>(i), documents[i],
+                          DocumentStatus::ACTUAL, {1, 2, 3} });
+    }
+    search_server.AddDocuments(batch);
+    std::cout << search_server.GetDocumentCount() << std::endl;
+}
+
+void Test_Split_Into_Words(std::string_view mark,
+                           const std::vector<std::string>& documents) {
+    LOG_DURATION(mark);
+    size_t word_count = 0;
+    size_t invalid_count = 0;
+    for (const std::string& document : documents) {
+        ForEachWord(document,
+                    [&word_count, &invalid_count](std::string_view,
+                                                  bool is_valid) {
+                        ++word_count;
+                        invalid_count += is_valid ? 0 : 1;
+                    });
+    }
+    std::cout << word_count << " words, "s << invalid_count
+              << " invalid"s << std::endl;
+}
+
+void Test_Load_Snapshot(std::string_view mark,
+                        const std::string& path,
+                        const std::vector<std::string>& queries) {
+    LOG_DURATION(mark);
+    const SearchServer search_server = SearchServer::LoadSnapshot(path);
+    double total_relevance = 0;
+    for (const std::string_view query : queries) {
+        for (const auto& document :
+             search_server.FindTopDocuments(query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    std::cout << total_relevance << std::endl;
+}
+
+void Test_Add_Document_Logged(std::string_view mark,
+                              const std::string& stop_words,
+                              const std::vector<std::string>& documents,
+                              const std::string& log_path,
+                              LogDurability durability) {
+    std::remove(log_path.c_str());
+    LOG_DURATION(mark);
+    SearchServer search_server(stop_words);
+    auto log = std::make_shared<WriteAheadLog>(log_path);
+    search_server.AttachLog(log, durability);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i],
+                                  DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    log->WaitDurable(log->GetLastSequenceNumber());
+    std::cout << search_server.GetDocumentCount() << " documents, "s
+              << log->GetSyncCount() << " syncs"s << std::endl;
+}
+
+void Test_Recover(std::string_view mark,
+                  const std::string& snapshot_path,
+                  const std::string& log_path) {
+    LOG_DURATION(mark);
+    SearchServer search_server = SearchServer::LoadSnapshot(snapshot_path);
+    search_server.ReplayLog(log_path);
+    std::cout << search_server.GetDocumentCount() << std::endl;
+}
+
+void Test_Remove_And_Compact(std::string_view mark,
+                             SearchServer search_server,
+                             int removed_count) {
+    LOG_DURATION(mark);
+    for (int id = 0; id < removed_count; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.Compact();
+    std::cout << search_server.GetDocumentCount() << std::endl;
+}
+
+void Test_Near_Duplicates(std::string_view mark,
+                          const SearchServer& search_server,
+                          double threshold) {
+    LOG_DURATION(mark);
+    size_t document_count = 0;
+    const auto groups = search_server.GetNearDuplicates(threshold);
+    for (const auto& group : groups) {
+        document_count += group.size();
+    }
+    std::cout << groups.size() << " groups, "s << document_count
+              << " documents"s << std::endl;
+}
+
+void Test_Duplicates(std::string_view mark,
+                     const SearchServer& search_server) {
+    LOG_DURATION(mark);
+    std::cout << search_server.GetDuplicates().size() << std::endl;
+}
+
+void Test_Match_Document_Prepared(std::string_view mark,
+                                  const SearchServer& search_server,
+                                  const std::string& query) {
+    LOG_DURATION(mark);
+    const auto prepared = search_server.PrepareQuery(query);
+    int word_count = 0;
+    for (const int id : search_server) {
+        const auto [words, status] =
+              search_server.MatchDocument(prepared, id);
+        word_count += words.size();
+    }
+    std::cout << word_count << std::endl;
+}
+
+void Test_Match_Documents(std::string_view mark,
+                          const SearchServer& search_server,
+                          const std::string& query) {
+    LOG_DURATION(mark);
+    const std::vector<int> ids(search_server.begin(), search_server.end());
+    int word_count = 0;
+    for (const auto& [words, status] :
+         search_server.MatchDocuments(search_server.PrepareQuery(query),
+                                      ids)) {
+        word_count += words.size();
+    }
+    std::cout << word_count << std::endl;
+}
+
+void Test_Find_Document_With_All_Words(std::string_view mark,
+                                       const SearchServer& search_server,
+                                       const std::vector<std::string>& queries) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const std::string_view query : queries) {
+        for (const auto& document :
+             search_server.FindTopDocumentsWithAllWords(query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    std::cout << total_relevance << std::endl;
+}
+
+void Test_Find_Document_Sharded(std::string_view mark,
+                                const ShardedSearchServer& search_server,
+                                const std::vector<std::string>& queries) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const std::string_view query : queries) {
+        for (const auto& document :
+             search_server.FindTopDocuments(query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    std::cout << total_relevance << std::endl;
+}
+
+std::vector<int>
+GenerateKeys(std::mt19937& generator, int key_count, int max_key) {
+    std::vector<int> keys;
+    keys.reserve(key_count);
+    for (int i = 0; i < key_count; ++i) {
+        keys.push_back(
+            std::uniform_int_distribution(0, max_key)(generator));
+    }
+    return keys;
+}
+
+void Test_Concurrent_Map_Insert(std::string_view mark,
+                                const std::vector<int>& keys) {
+    LOG_DURATION(mark);
+    ConcurrentMap<int, double> map(keys.size());
+    std::for_each(std::execution::par, keys.begin(), keys.end(),
+                  [&map](int key) {
+                      map[key].ref_to_value += 1.0;
+                  });
+    std::cout << map.Drain().size() << std::endl;
+}
+
+void Test_Concurrent_Map_Erase(std::string_view mark,
+                               const std::vector<int>& keys) {
+    ConcurrentMap<int, double> map(keys.size());
+    for (const int key : keys) {
+        map[key].ref_to_value += 1.0;
+    }
+
+    LOG_DURATION(mark);
+    std::for_each(std::execution::par, keys.begin(), keys.end(),
+                  [&map](int key) {
+                      if (key % 4 != 0) {
+                          map.Erase(key);
+                      }
+                  });
+    std::cout << map.Drain().size() << std::endl;
+}
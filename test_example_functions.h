@@ -1,10 +1,16 @@
 #pragma once
 
+#include "concurrent_map.h"
+#include "concurrent_search_server.h"
 #include "log_duration.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
 
+#include <atomic>
 #include <iostream>
 #include <random>
+#include <shared_mutex>
+#include <thread>
 
 std::string
 GenerateWord(std::mt19937& generator, int max_length);
@@ -33,6 +39,21 @@ GenerateQueries2(std::mt19937& generator,
                  const std::vector<std::string>& dictionary,
                  int query_count, int max_word_count);
 
+// Picks count queries out of queries with a heavy head: the first 1%
+// of them make about 40% of the result.
+std::vector<std::string>
+GenerateSkewedQueries(std::mt19937& generator,
+                      const std::vector<std::string>& queries,
+                      int count);
+
+// Copies of copy_count random documents, each with up to changed_count
+// of its words replaced by dictionary words.
+std::vector<std::string>
+GenerateNearCopies(std::mt19937& generator,
+                   const std::vector<std::string>& documents,
+                   const std::vector<std::string>& dictionary,
+                   int copy_count, int changed_count);
+
 // ProcessQueries test
 template <typename QueriesProcessor>
 void Test_Process_Queries(std::string_view mark,
@@ -45,6 +66,74 @@ void Test_Process_Queries(std::string_view mark,
 
 #define TEST_PROCESS_QUERIES(processor) Test_Process_Queries(#processor, processor, ss, queries)
 
+// AddDocument tests
+void Test_Add_Document(std::string_view mark,
+                       const std::string& stop_words,
+                       const std::vector<std::string>& documents);
+
+void Test_Add_Documents(std::string_view mark,
+                        const std::string& stop_words,
+                        const std::vector<std::string>& documents);
+
+// Tokenizer test
+void Test_Split_Into_Words(std::string_view mark,
+                           const std::vector<std::string>& documents);
+
+// Snapshot test
+void Test_Load_Snapshot(std::string_view mark,
+                        const std::string& path,
+                        const std::vector<std::string>& queries);
+
+// Write-ahead log tests
+void Test_Add_Document_Logged(std::string_view mark,
+                              const std::string& stop_words,
+                              const std::vector<std::string>& documents,
+                              const std::string& log_path,
+                              LogDurability durability);
+
+void Test_Recover(std::string_view mark,
+                  const std::string& snapshot_path,
+                  const std::string& log_path);
+
+// Concurrent updates test
+// Splits the queries over reader threads while another thread calls
+// update(step) until they are done; update returns whether it changed
+// anything.
+template <typename QueryFunction, typename UpdateFunction>
+void Test_Queries_With_Updates(std::string_view mark,
+                               const std::vector<std::string>& queries,
+                               QueryFunction query,
+                               UpdateFunction update) {
+    std::atomic<bool> is_done = false;
+    int update_count = 0;
+    std::thread writer([&is_done, &update_count, &update] {
+        for (int step = 0; !is_done; ++step) {
+            update_count += update(step);
+        }
+    });
+
+    {
+        LOG_DURATION(mark);
+        const size_t reader_count =
+            std::max(2u, std::thread::hardware_concurrency());
+        std::vector<std::thread> readers;
+        for (size_t reader = 0; reader < reader_count; ++reader) {
+            readers.emplace_back([&queries, &query, reader, reader_count] {
+                for (size_t i = reader; i < queries.size();
+                     i += reader_count) {
+                    query(queries[i]);
+                }
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+    }
+    is_done = true;
+    writer.join();
+    std::cout << update_count << " updates"s << std::endl;
+}
+
 // RemoveDocument test
 template <typename ExecutionPolicy>
 void Test_Remove_Document(std::string_view mark,
@@ -60,6 +149,19 @@ void Test_Remove_Document(std::string_view mark,
 
 #define TEST_REMOVE_DOCUMENT(mode) Test_Remove_Document(#mode, ss, std::execution::mode)
 
+// Compact test
+void Test_Remove_And_Compact(std::string_view mark,
+                             SearchServer search_server,
+                             int removed_count);
+
+// Near-duplicates tests
+void Test_Near_Duplicates(std::string_view mark,
+                          const SearchServer& search_server,
+                          double threshold);
+
+void Test_Duplicates(std::string_view mark,
+                     const SearchServer& search_server);
+
 // MatchDocument test
 template <typename ExecutionPolicy>
 void Test_Match_Document(std::string_view mark,
@@ -80,6 +182,36 @@ void Test_Match_Document(std::string_view mark,
 
 #define TEST_MATCH_DOCUMENT(policy) Test_Match_Document(#policy, ss, queries, std::execution::policy)
 
+void Test_Match_Document_Prepared(std::string_view mark,
+                                  const SearchServer& search_server,
+                                  const std::string& query);
+
+void Test_Match_Documents(std::string_view mark,
+                          const SearchServer& search_server,
+                          const std::string& query);
+
+// GetWordFrequencies test
+template <typename ExecutionPolicy>
+void Test_Word_Frequencies(std::string_view mark,
+                           const SearchServer& search_server,
+                           ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    const std::vector<int> ids(search_server.begin(), search_server.end());
+    std::vector<double> sums(ids.size());
+    std::transform(policy, ids.begin(), ids.end(), sums.begin(),
+                   [&search_server](int id) {
+                       double sum = 0.0;
+                       for (const auto& [word, term_freq] :
+                            search_server.GetWordFrequencies(id)) {
+                           sum += term_freq * word.size();
+                       }
+                       return sum;
+                   });
+    std::cout << std::reduce(sums.begin(), sums.end()) << std::endl;
+}
+
+#define TEST_WORD_FREQUENCIES(policy) Test_Word_Frequencies(#policy, ss, std::execution::policy)
+
 // FindDocument test
 template <typename ExecutionPolicy>
 void Test_Find_Document(std::string_view mark,
@@ -97,4 +229,31 @@ void Test_Find_Document(std::string_view mark,
     std::cout << total_relevance << std::endl;
 }
 
-#define TEST_FIND_DOCUMENT(policy) Test_Find_Document(#policy, ss, queries, std::execution::policy)
\ No newline at end of file
+#define TEST_FIND_DOCUMENT(policy) Test_Find_Document(#policy, ss, queries, std::execution::policy)
+
+// Conjunctive FindDocument test
+void Test_Find_Document_With_All_Words(std::string_view mark,
+                                       const SearchServer& search_server,
+                                       const std::vector<std::string>& queries);
+
+// ShardedSearchServer FindDocument test
+void Test_Find_Document_Sharded(std::string_view mark,
+                                const ShardedSearchServer& search_server,
+                                const std::vector<std::string>& queries);
+
+// ConcurrentMap tests
+std::vector<int>
+GenerateKeys(std::mt19937& generator, int key_count, int max_key);
+
+void Test_Concurrent_Map_Insert(std::string_view mark,
+                                const std::vector<int>& keys);
+
+void Test_Concurrent_Map_Erase(std::string_view mark,
+                               const std::vector<int>& keys);
+
+#define TEST_CONCURRENT_MAP_INSERT(keys) Test_Concurrent_Map_Insert("insert "#keys, keys)
+#define TEST_CONCURRENT_MAP_ERASE(keys) Test_Concurrent_Map_Erase("erase "#keys, keys)
+
+#define TEST_FIND_DOCUMENT_WITH_ALL_WORDS(queries) Test_Find_Document_With_All_Words("all words "#queries, ss, queries)
+
+#define TEST_FIND_DOCUMENT_SHARDED(shard_count) Test_Find_Document_Sharded(#shard_count " shards", sharded_ss_##shard_count, queries)
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "word_frequencies.h"
+
+#include <algorithm>
+
+WordFrequencies::WordFrequencies(const Entry* begin, const Entry* end,
+                                 const TermInterner* terms)
+    : begin_(begin)
+    , end_(end)
+    , terms_(terms)
+{
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return { begin_, terms_ };
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return { end_, terms_ };
+}
+
+size_t WordFrequencies::size() const {
+    return end_ - begin_;
+}
+
+bool WordFrequencies::empty() const {
+    return begin_ == end_;
+}
+
+// Entries are sorted by term id, the word is looked up once and its id
+// searched for.
+std::optional<double> WordFrequencies::Find(std::string_view word) const {
+    if (empty()) {
+        return std::nullopt;
+    }
+    const uint32_t term = terms_->Find(word);
+    const Entry* entry = std::lower_bound(
+        begin_, end_, term,
+        [](const Entry& entry, uint32_t term) {
+            return entry.first < term;
+        });
+    if (entry == end_ || entry->first != term) {
+        return std::nullopt;
+    }
+    return entry->second;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "term_interner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+// Read-only view of the word frequencies of one document of a
+// SearchServer: (word, term frequency) pairs in the order of the term
+// ids of the words. It points into the forward index and the vocabulary
+// of the server and copies nothing, so taking and reading views is safe
+// from any number of threads at once. A view stays valid while its
+// document is in the server; removing the document, or destroying,
+// moving or assigning to the server, invalidates it. Adding other
+// documents does not.
+class WordFrequencies {
+public:
+    // Layout of the forward index entries.
+    using Entry = std::pair<uint32_t, double>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const Entry* entry, const TermInterner* terms)
+            : entry_(entry)
+            , terms_(terms)
+        {
+        }
+
+        value_type operator*() const {
+            return { terms_->GetTerm(entry_->first), entry_->second };
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++entry_;
+            return result;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const Entry* entry_ = nullptr;
+        const TermInterner* terms_ = nullptr;
+    };
+
+    // Empty, the view of a missing document.
+    WordFrequencies() = default;
+
+    WordFrequencies(const Entry* begin, const Entry* end,
+                    const TermInterner* terms);
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    // Term frequency of word, nothing when the document lacks it.
+    std::optional<double> Find(std::string_view word) const;
+
+private:
+    const Entry* begin_ = nullptr;
+    const Entry* end_ = nullptr;
+    const TermInterner* terms_ = nullptr;
+};
@@ -0,0 +1,338 @@
+#include "write_ahead_log.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+template <typename T>
+void PutValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool GetValue(std::string_view& in, T& value) {
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+uint64_t ComputeRecordChecksum(LogRecordHeader header,
+                               const std::string& payload) {
+    header.checksum = 0;
+    SnapshotChecksum checksum;
+    checksum.Update(&header, sizeof(header));
+    checksum.Update(payload.data(), payload.size());
+    return checksum.Value();
+}
+
+bool ParsePayload(std::string_view payload, LogRecord& record) {
+    int32_t document_id = 0;
+    if (!GetValue(payload, document_id)) {
+        return false;
+    }
+    record.document_id = document_id;
+    record.status = DocumentStatus::ACTUAL;
+    record.ratings.clear();
+    record.text.clear();
+    if (record.type == LogRecordType::REMOVE_DOCUMENT) {
+        return payload.empty();
+    }
+
+    int32_t status = 0;
+    uint32_t rating_count = 0;
+    if (!GetValue(payload, status) || !GetValue(payload, rating_count)
+        || status < 0
+        || status > static_cast<int32_t>(DocumentStatus::REMOVED)
+        || rating_count > payload.size() / sizeof(int32_t)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(rating_count);
+    for (int& rating : record.ratings) {
+        int32_t value = 0;
+        GetValue(payload, value);
+        rating = value;
+    }
+    record.text = payload;
+    return true;
+}
+
+} // namespace
+
+// LogReader
+
+LogReader::LogReader(const std::string& path)
+    : in_(path, std::ios::binary)
+{
+    if (in_) {
+        in_.seekg(0, std::ios::end);
+        file_size_ = in_.tellg();
+        in_.seekg(0);
+    }
+}
+
+bool LogReader::Next(LogRecord& record) {
+    LogRecordHeader header;
+    if (!in_ || file_size_ - valid_size_ < sizeof(header)) {
+        return false;
+    }
+    in_.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in_ || header.payload_size
+                > file_size_ - valid_size_ - sizeof(header)) {
+        return false;
+    }
+    payload_.resize(header.payload_size);
+    in_.read(payload_.data(), payload_.size());
+    if (!in_ || header.sequence_number <= last_sequence_number_
+        || ComputeRecordChecksum(header, payload_) != header.checksum) {
+        return false;
+    }
+
+    record.sequence_number = header.sequence_number;
+    record.type = static_cast<LogRecordType>(header.type);
+    if ((record.type != LogRecordType::ADD_DOCUMENT
+         && record.type != LogRecordType::REMOVE_DOCUMENT)
+        || !ParsePayload(payload_, record)) {
+        return false;
+    }
+    last_sequence_number_ = header.sequence_number;
+    valid_size_ += sizeof(header) + header.payload_size;
+    return true;
+}
+
+uint64_t LogReader::GetValidSize() const {
+    return valid_size_;
+}
+
+// WriteAheadLog
+
+WriteAheadLog::WriteAheadLog(const std::string& path)
+    : path_(path)
+{
+    LogReader reader(path);
+    LogRecord record;
+    while (reader.Next(record)) {
+        last_sequence_number_ = record.sequence_number;
+    }
+    durable_sequence_number_ = last_sequence_number_;
+    Open(reader.GetValidSize());
+    flusher_ = std::thread([this] { Flush(); });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    queued_.notify_one();
+    flusher_.join();
+    Close();
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id,
+                                          const std::string_view document,
+                                          DocumentStatus status,
+                                          const std::vector<int>& ratings) {
+    std::string payload;
+    payload.reserve(3 * sizeof(int32_t) + ratings.size() * sizeof(int32_t)
+                    + document.size());
+    PutValue<int32_t>(payload, document_id);
+    PutValue<int32_t>(payload, static_cast<int32_t>(status));
+    PutValue<uint32_t>(payload, ratings.size());
+    for (const int rating : ratings) {
+        PutValue<int32_t>(payload, rating);
+    }
+    payload += document;
+    return Append(LogRecordType::ADD_DOCUMENT, payload);
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    std::string payload;
+    PutValue<int32_t>(payload, document_id);
+    return Append(LogRecordType::REMOVE_DOCUMENT, payload);
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence_number) {
+    std::unique_lock lock(mutex_);
+    synced_.wait(lock, [this, sequence_number] {
+        return durable_sequence_number_ >= sequence_number || error_;
+    });
+    if (durable_sequence_number_ < sequence_number) {
+        std::rethrow_exception(error_);
+    }
+}
+
+uint64_t WriteAheadLog::GetLastSequenceNumber() const {
+    std::lock_guard guard(mutex_);
+    return last_sequence_number_;
+}
+
+uint64_t WriteAheadLog::GetSyncCount() const {
+    std::lock_guard guard(mutex_);
+    return sync_count_;
+}
+
+// PRIVATE
+
+uint64_t WriteAheadLog::Append(LogRecordType type,
+                               const std::string& payload) {
+    LogRecordHeader header{ static_cast<uint32_t>(payload.size()),
+                            static_cast<uint32_t>(type), 0, 0 };
+    std::lock_guard guard(mutex_);
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    header.sequence_number = ++last_sequence_number_;
+    header.checksum = ComputeRecordChecksum(header, payload);
+    queue_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    queue_ += payload;
+    queued_.notify_one();
+    return header.sequence_number;
+}
+
+// Body of the flusher thread. The records of a group are written
+// outside the lock, Append keeps filling the queue meanwhile.
+void WriteAheadLog::Flush() {
+    std::string group;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        queued_.wait(lock, [this] {
+            return is_stopping_ || !queue_.empty();
+        });
+        if (queue_.empty()) {
+            return;
+        }
+        group.swap(queue_);
+        const uint64_t sequence_number = last_sequence_number_;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            WriteToFile(group);
+            SyncFile();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        group.clear();
+
+        lock.lock();
+        if (error) {
+            error_ = error;
+        } else {
+            durable_sequence_number_ = sequence_number;
+            ++sync_count_;
+        }
+        synced_.notify_all();
+        if (error_) {
+            return;
+        }
+    }
+}
+
+#ifdef _WIN32
+
+void WriteAheadLog::Open(uint64_t valid_size) {
+    file_ = CreateFileA(path_.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+                        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                        nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw std::runtime_error("Cannot open "s + path_);
+    }
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(valid_size);
+    if (!SetFilePointerEx(file_, position, nullptr, FILE_BEGIN)
+        || !SetEndOfFile(file_) || !FlushFileBuffers(file_)) {
+        Close();
+        throw std::runtime_error("Cannot truncate "s + path_);
+    }
+}
+
+void WriteAheadLog::Close() {
+    CloseHandle(file_);
+}
+
+void WriteAheadLog::WriteToFile(const std::string& data) {
+    const char* bytes = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(
+                            std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(file_, bytes, chunk, &written, nullptr)) {
+            throw std::runtime_error("Cannot write "s + path_);
+        }
+        bytes += written;
+        size -= written;
+    }
+}
+
+void WriteAheadLog::SyncFile() {
+    if (!FlushFileBuffers(file_)) {
+        throw std::runtime_error("Cannot sync "s + path_);
+    }
+}
+
+#else
+
+void WriteAheadLog::Open(uint64_t valid_size) {
+    file_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (file_ < 0) {
+        throw std::runtime_error("Cannot open "s + path_);
+    }
+    if (ftruncate(file_, valid_size) != 0 || fsync(file_) != 0) {
+        Close();
+        throw std::runtime_error("Cannot truncate "s + path_);
+    }
+}
+
+void WriteAheadLog::Close() {
+    close(file_);
+}
+
+void WriteAheadLog::WriteToFile(const std::string& data) {
+    const char* bytes = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        const ssize_t written = write(file_, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Cannot write "s + path_);
+        }
+        bytes += written;
+        size -= written;
+    }
+}
+
+void WriteAheadLog::SyncFile() {
+#ifdef __linux__
+    const int result = fdatasync(file_);
+#else
+    const int result = fsync(file_);
+#endif
+    if (result != 0) {
+        throw std::runtime_error("Cannot sync "s + path_);
+    }
+}
+
+#endif
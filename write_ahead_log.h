@@ -0,0 +1,136 @@
+#pragma once
+
+#include "document.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Append-only log of the mutations of a SearchServer, see
+// SearchServer::AttachLog and SearchServer::ReplayLog.
+//
+// The file is a sequence of records, each a LogRecordHeader followed by
+// its payload. Records are numbered from 1 in the order they are
+// appended. The first record that is cut short or fails its checksum,
+// normally the one being written when the process died, ends the log:
+// reading stops there and a WriteAheadLog opened on the file cuts it
+// off before appending.
+
+enum class LogRecordType : uint32_t {
+    ADD_DOCUMENT = 1,    // id, status, rating count, ratings, text
+    REMOVE_DOCUMENT = 2  // id
+};
+
+struct LogRecordHeader {
+    uint32_t payload_size;
+    uint32_t type;
+    uint64_t sequence_number;
+    uint64_t checksum; // of the header with checksum 0 and the payload
+};
+
+struct LogRecord {
+    uint64_t sequence_number = 0;
+    LogRecordType type = LogRecordType::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// When a mutation of a server with a log returns: after its record is
+// on disk, or at once, leaving the record to the next group the log
+// syncs. A crash then loses at most the records of one group.
+enum class LogDurability {
+    SYNC,
+    DEFERRED
+};
+
+// Reads a log file record by record. A missing file is an empty log.
+class LogReader {
+public:
+    explicit LogReader(const std::string& path);
+
+    // False at the end of the log.
+    bool Next(LogRecord& record);
+
+    // Bytes taken by the records read so far.
+    uint64_t GetValidSize() const;
+
+private:
+    std::ifstream in_;
+    uint64_t file_size_ = 0;
+    uint64_t valid_size_ = 0;
+    uint64_t last_sequence_number_ = 0;
+    std::string payload_;
+};
+
+// Writes records with group commit. Append only queues a record; a
+// flusher thread takes everything queued since its previous round and
+// writes it with one write and one sync, so records appended while a
+// sync is in flight share the next one. WaitDurable blocks until a
+// record is on disk. Throws std::runtime_error when the file cannot be
+// opened or written; after a failed write every later call throws.
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& path);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Writes out whatever is still queued.
+    ~WriteAheadLog();
+
+    uint64_t AppendAddDocument(int document_id,
+                               const std::string_view document,
+                               DocumentStatus status,
+                               const std::vector<int>& ratings);
+
+    uint64_t AppendRemoveDocument(int document_id);
+
+    void WaitDurable(uint64_t sequence_number);
+
+    // Number of the last record appended, 0 for an empty log.
+    uint64_t GetLastSequenceNumber() const;
+
+    // Syncs done so far, each one covers a group of records.
+    uint64_t GetSyncCount() const;
+
+private:
+    std::string path_;
+#ifdef _WIN32
+    void* file_ = nullptr;
+#else
+    int file_ = -1;
+#endif
+
+    mutable std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable synced_;
+    std::string queue_;
+    uint64_t last_sequence_number_ = 0;
+    uint64_t durable_sequence_number_ = 0;
+    uint64_t sync_count_ = 0;
+    bool is_stopping_ = false;
+    std::exception_ptr error_;
+    // Started last, once the rest is set up.
+    std::thread flusher_;
+
+    uint64_t Append(LogRecordType type, const std::string& payload);
+
+    void Flush();
+
+    void Open(uint64_t valid_size);
+
+    void Close();
+
+    void WriteToFile(const std::string& data);
+
+    void SyncFile();
+};